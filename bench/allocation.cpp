@@ -0,0 +1,71 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <string>
+#include <type_traits>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace
+{
+  template <typename Tree>
+  void insert_and_clear(const char* name, std::size_t n)
+  {
+    auto keys = bench::shuffled_keys(n);
+    Tree tree;
+    auto insertion = bench::measure([&] { for (auto key : keys) tree.insert(key); });
+    bench::report(name, n, insertion, n);
+    // per whole clear(), which is O(n) for heap nodes and O(number of slabs) for pooled ones
+    auto clearing = bench::measure([&] { tree.clear(); });
+    bench::report("  clear", n, clearing, 1);
+  }
+
+  // bytes the heap hands out to the program, nothing to compare against outside glibc
+  std::size_t heap_in_use()
+  {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    auto info = mallinfo2();
+    // large blocks are mapped separately and aren't part of uordblks
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+  }
+
+  template <typename Tree>
+  void memory_of(const std::string& name, std::size_t n)
+  {
+    auto keys = bench::shuffled_keys(n);
+    Tree tree;
+    auto heap = heap_in_use();
+    auto allocated = bench::count_allocations([&] { for (auto key : keys) tree.insert(key); });
+    auto per_element = [n](std::size_t bytes) { return static_cast<double>(bytes) / static_cast<double>(n); };
+    bench::report_value(name + " sizeof(node_t)", n, sizeof(typename Tree::node_t), "bytes");
+    bench::report_value(name + " requested", n, per_element(allocated.second), "bytes/element");
+    if (heap)
+      bench::report_value(name + " heap in use", n, per_element(heap_in_use() - heap), "bytes/element");
+    if constexpr (std::is_same<std::decay_t<decltype(tree.node_allocator())>, btree::node_pool<typename Tree::node_t>>::value)
+      bench::report_value(name + " slab bytes / size()", n, per_element(tree.node_allocator().slab_bytes()), "bytes/element");
+  }
+}
+
+BENCHMARK(pooled_allocation)
+{
+  for (auto n : bench::sizes())
+  {
+    insert_and_clear<btree::rb_tree<int>>("rb_tree insert", n);
+    insert_and_clear<btree::pooled_rb_tree<int>>("pooled_rb_tree insert", n);
+  }
+}
+
+// heap nodes pay the allocator header and rounding on top of sizeof(node_t), slabs only their spare slots
+BENCHMARK(memory_per_element)
+{
+  for (auto n : bench::sizes())
+  {
+    memory_of<btree::rb_tree<int>>("rb_tree", n);
+    memory_of<btree::indexed_rb_tree<int>>("indexed_rb_tree", n);
+    memory_of<btree::pooled_rb_tree<int>>("pooled_rb_tree", n);
+    memory_of<btree::pooled_indexed_rb_tree<int>>("pooled_indexed_rb_tree", n);
+  }
+}
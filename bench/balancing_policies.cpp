@@ -0,0 +1,72 @@
+#include "bench.h"
+#include "comp/avl_tree.h"
+#include "comp/btree.h"
+#include "comp/splay_tree.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace
+{
+  using workload = std::pair<std::string, std::vector<int>>;
+
+  // key of rank k (from 1) is queried with probability proportional to 1/k, ranks are assigned to keys at random
+  std::vector<int> zipf_queries(const std::vector<int>& keys)
+  {
+    std::vector<double> cumulative(keys.size());
+    double total = 0;
+    for (std::size_t k = 0; k < keys.size(); ++k)
+      cumulative[k] = total += 1.0 / static_cast<double>(k + 1);
+
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> uniform(0, total);
+    std::vector<int> queries(keys.size());
+    for (auto& query : queries)
+    {
+      auto rank = std::upper_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin();
+      query = keys[std::min<std::size_t>(static_cast<std::size_t>(rank), keys.size() - 1)];
+    }
+    return queries;
+  }
+
+  std::vector<workload> workloads(const std::vector<int>& keys)
+  {
+    auto sequential = keys;
+    std::sort(sequential.begin(), sequential.end());
+    return {{"uniform", bench::shuffled_keys(keys.size(), 2)}, {"zipf", zipf_queries(keys)}, {"sequential", sequential}};
+  }
+
+  // every workload runs on a freshly built tree, so what a splay tree learned from one doesn't help the next
+  template <typename Tree>
+  void run(const std::string& name, std::size_t n, const std::vector<int>& keys, const std::vector<workload>& patterns)
+  {
+    for (const auto& pattern : patterns)
+    {
+      Tree tree;
+      auto seconds = bench::measure([&] { for (auto key : keys) tree.insert(key); });
+      if (&pattern == &patterns.front())
+        bench::report(name + " insert", n, seconds, n);
+      const auto& queries = pattern.second;
+      bench::report(name + " find " + pattern.first, n, bench::measure([&] { for (auto key : queries) bench::keep(tree.find(key) != tree.end()); }), n);
+    }
+
+    Tree tree;
+    const auto& sorted = patterns.back().second;
+    bench::report(name + " insert sequential", n, bench::measure([&] { for (auto key : sorted) tree.insert(key); }), n);
+    bench::report(name + " erase sequential", n, bench::measure([&] { for (auto key : sorted) tree.erase(key); }), n);
+  }
+}
+
+// all three take O(log n), amortized for splay tree which in turn finds recently used keys near the root
+BENCHMARK(balancing_policies)
+{
+  for (auto n : bench::sizes())
+  {
+    auto keys = bench::shuffled_keys(n);
+    auto patterns = workloads(keys);
+    run<btree::rb_tree<int>>("rb_tree", n, keys, patterns);
+    run<btree::avl_tree<int>>("avl_tree", n, keys, patterns);
+    run<btree::splay_tree<int>>("splay_tree", n, keys, patterns);
+  }
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Every benchmark prints time per operation for growing sizes, so the way it changes with n
+// shows the complexity: flat for O(1) or O(n) per whole operation, slowly growing for O(log n).
+namespace bench
+{
+  struct entry
+  {
+    const char* name;
+    void (*run)();
+  };
+
+  inline std::vector<entry>& registry()
+  {
+    static std::vector<entry> entries;
+    return entries;
+  }
+
+  struct registrar
+  {
+    registrar(const char* name, void (*run)()) { registry().push_back({name, run}); }
+  };
+
+  // largest size benchmarks go up to, set from the command line
+  inline std::size_t& max_size()
+  {
+    static std::size_t size = std::size_t(1) << 20;
+    return size;
+  }
+
+  // sizes growing eightfold, the last one is max_size()
+  inline std::vector<std::size_t> sizes()
+  {
+    std::vector<std::size_t> result;
+    for (std::size_t size = std::size_t(1) << 11; size < max_size(); size <<= 3)
+      result.push_back(size);
+    result.push_back(max_size());
+    return result;
+  }
+
+  // seconds taken by f()
+  template <typename Function>
+  double measure(Function&& f)
+  {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  inline void report_value(const std::string& what, std::size_t n, double value, const char* unit)
+  {
+    std::printf("  %-44s n=%-10zu %10.1f %s\n", what.c_str(), n, value, unit);
+  }
+
+  inline void report(const std::string& what, std::size_t n, double seconds, std::size_t operations)
+  {
+    report_value(what, n, seconds * 1e9 / static_cast<double>(operations), "ns/op");
+  }
+
+  // totals of every operator new call of the program, counted by the replacement in main.cpp
+  struct allocation_counters
+  {
+    std::atomic<std::size_t> count {0};
+    std::atomic<std::size_t> bytes {0};
+  };
+
+  inline allocation_counters& allocations()
+  {
+    static allocation_counters counters;
+    return counters;
+  }
+
+  // number and total size of allocations made by f()
+  template <typename Function>
+  std::pair<std::size_t, std::size_t> count_allocations(Function&& f)
+  {
+    auto count = allocations().count.load();
+    auto bytes = allocations().bytes.load();
+    f();
+    return {allocations().count.load() - count, allocations().bytes.load() - bytes};
+  }
+
+  // keeps the optimizer from dropping computations whose result isn't used otherwise
+  template <typename T>
+  void keep(const T& value)
+  {
+    static thread_local volatile std::size_t sink;
+    sink = sink + static_cast<std::size_t>(value);
+  }
+
+  // 0, 2, 4, ... 2 (n - 1) in random order, odd numbers are absent
+  inline std::vector<int> shuffled_keys(std::size_t n, unsigned seed = 1)
+  {
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    for (auto& key : keys)
+      key *= 2;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(seed));
+    return keys;
+  }
+
+  inline std::vector<int> sorted_keys(std::size_t n)
+  {
+    auto keys = shuffled_keys(n);
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  }
+} // namespace bench
+
+#define BENCHMARK(name) \
+  static void name(); \
+  static bench::registrar name##_registrar(#name, name); \
+  static void name()
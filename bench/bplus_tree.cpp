@@ -0,0 +1,42 @@
+#include "bench.h"
+#include "comp/bplus_tree.h"
+#include "comp/btree.h"
+#include <set>
+#include <string>
+
+namespace
+{
+  template <typename Tree>
+  void insert_find_erase(const std::string& name, std::size_t n)
+  {
+    auto keys = bench::shuffled_keys(n);
+    auto lookups = bench::shuffled_keys(n, 2);
+    Tree tree;
+    bench::report(name + " insert", n, bench::measure([&] { for (auto key : keys) tree.insert(key); }), n);
+    bench::report(name + " find", n, bench::measure([&]
+    {
+      for (auto key : lookups)
+        bench::keep(*tree.find(key));
+    }), n);
+    bench::report(name + " full scan", n, bench::measure([&]
+    {
+      long long sum = 0;
+      for (auto key : tree)
+        sum += key;
+      bench::keep(sum);
+    }), n);
+    bench::report(name + " erase", n, bench::measure([&] { for (auto key : lookups) tree.erase(key); }), n);
+  }
+}
+
+// all are O(log n) per operation and O(n) per scan, the multiway tree touches fewer cache lines for both
+// and its scan walks linked leaves instead of climbing between nodes
+BENCHMARK(bplus_tree)
+{
+  for (auto n : bench::sizes())
+  {
+    insert_find_erase<std::set<int>>("std::set", n);
+    insert_find_erase<btree::rb_tree<int>>("rb_tree", n);
+    insert_find_erase<btree::bplus_tree<int>>("bplus_tree", n);
+  }
+}
@@ -0,0 +1,48 @@
+#include "bench.h"
+#include "comp/btree.h"
+
+namespace
+{
+  template <typename Tree>
+  void build(const char* name, std::size_t n)
+  {
+    auto sorted = bench::sorted_keys(n);
+    Tree tree;
+    auto seconds = bench::measure([&] { tree.assign_sorted(sorted.begin(), sorted.end()); });
+    bench::report(name, n, seconds, n);
+  }
+}
+
+// assign_sorted is O(n), so time per key stays flat while insertion grows with log n
+BENCHMARK(sorted_build)
+{
+  for (auto n : bench::sizes())
+  {
+    auto sorted = bench::sorted_keys(n);
+    btree::rb_tree<int> inserted;
+    auto seconds = bench::measure([&] { for (auto key : sorted) inserted.insert(key); });
+    bench::report("rb_tree insert one by one", n, seconds, n);
+    build<btree::rb_tree<int>>("rb_tree assign_sorted", n);
+    build<btree::indexed_rb_tree<int>>("indexed_rb_tree assign_sorted", n);
+  }
+}
+
+// sorting dominates assign() from unsorted input, more threads divide it
+BENCHMARK(parallel_build)
+{
+  for (auto n : bench::sizes())
+  {
+    auto keys = bench::shuffled_keys(n);
+    btree::rb_tree<int> inserted;
+    auto seconds = bench::measure([&] { for (auto key : keys) inserted.insert(key); });
+    bench::report("rb_tree insert one by one", n, seconds, n);
+    for (unsigned thread_count : {1u, 2u, 4u, 8u})
+    {
+      btree::rb_tree<int> tree;
+      seconds = bench::measure([&] { tree.assign(keys.begin(), keys.end(), thread_count); });
+      char name[64];
+      std::snprintf(name, sizeof(name), "rb_tree assign, thread_count %u", thread_count);
+      bench::report(name, n, seconds, n);
+    }
+  }
+}
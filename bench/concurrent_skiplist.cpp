@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include "comp/concurrent_skiplist.h"
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+  // baseline: the whole tree behind one mutex, with the set semantics of concurrent_skiplist
+  class locked_rb_tree
+  {
+  public:
+    bool insert(int key)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_tree.contains(key))
+        return false;
+      m_tree.insert(key);
+      return true;
+    }
+
+    bool contains(int key) const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_tree.contains(key);
+    }
+
+    bool erase(int key)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_tree.erase(key) != 0;
+    }
+
+  private:
+    mutable std::mutex m_mutex;
+    btree::rb_tree<int> m_tree;
+  };
+
+  // every thread inserts, looks up and erases its own share of the keys, returns seconds taken
+  template <typename Set>
+  double mixed_workload(Set& set, const std::vector<int>& keys, unsigned thread_count)
+  {
+    auto n = keys.size();
+    return bench::measure([&]
+    {
+      std::vector<std::thread> threads;
+      for (unsigned t = 0; t < thread_count; ++t)
+        threads.emplace_back([&, t]
+        {
+          for (std::size_t i = t; i < n; i += thread_count)
+            set.insert(keys[i]);
+          for (std::size_t i = t; i < n; i += thread_count)
+            bench::keep(set.contains(keys[i] + 1));
+          for (std::size_t i = t; i < n; i += thread_count)
+            set.erase(keys[i]);
+        });
+      for (auto& thread : threads)
+        thread.join();
+    });
+  }
+}
+
+// expected O(log n) per operation, lookups take no locks
+BENCHMARK(concurrent_skiplist)
+{
+  std::vector<unsigned> thread_counts {1, 2, 4};
+  auto hardware = std::max(std::thread::hardware_concurrency(), 1u);
+  if (hardware > 4)
+    thread_counts.push_back(hardware);
+
+  for (auto n : bench::sizes())
+  {
+    auto keys = bench::shuffled_keys(n);
+    btree::concurrent_skiplist<int> set;
+    bench::report("insert", n, bench::measure([&] { for (auto key : keys) set.insert(key); }), n);
+    bench::report("contains", n, bench::measure([&] { for (auto key : keys) bench::keep(set.contains(key + key / 2 % 2)); }), n);
+    bench::report("erase", n, bench::measure([&] { for (auto key : keys) set.erase(key); }), n);
+    bench::report("reclaim", n, bench::measure([&] { bench::keep(set.reclaim()); }), n);
+
+    for (auto thread_count : thread_counts)
+    {
+      auto suffix = ", threads " + std::to_string(thread_count);
+      bench::report("skiplist insert, contains and erase" + suffix, n, mixed_workload(set, keys, thread_count), 3 * n);
+      set.reclaim();
+      locked_rb_tree tree;
+      bench::report("mutex + rb_tree insert, contains and erase" + suffix, n, mixed_workload(tree, keys, thread_count), 3 * n);
+    }
+  }
+}
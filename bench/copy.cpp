@@ -0,0 +1,33 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <string>
+
+namespace
+{
+  template <typename Tree>
+  void copies(const std::string& name, std::size_t n)
+  {
+    auto keys = bench::shuffled_keys(n);
+    Tree tree;
+    for (auto key : keys)
+      tree.insert(key);
+    bench::report(name + " copy", n, bench::measure([&] { Tree copy(tree); bench::keep(copy.size()); }), n);
+    bench::report(name + " reinsert every key", n, bench::measure([&]
+    {
+      Tree copy;
+      for (auto key : tree)
+        copy.insert(key);
+      bench::keep(copy.size());
+    }), n);
+  }
+}
+
+// copying repeats the shape node by node in O(n) without comparisons, reinsertion takes O(n log n)
+BENCHMARK(structural_copy)
+{
+  for (auto n : bench::sizes())
+  {
+    copies<btree::rb_tree<int>>("rb_tree", n);
+    copies<btree::pooled_indexed_rb_tree<int>>("pooled_indexed_rb_tree", n);
+  }
+}
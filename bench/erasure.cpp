@@ -0,0 +1,40 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <array>
+#include <string>
+
+namespace
+{
+  struct wide_key
+  {
+    int value;
+    std::array<char, 252> payload;
+
+    bool operator<(const wide_key& other) const { return value < other.value; }
+  };
+
+  template <typename KeyType, typename MakeKey>
+  void erase_all(const std::string& name, std::size_t n, MakeKey make_key)
+  {
+    auto keys = bench::shuffled_keys(n);
+    btree::rb_tree<KeyType> tree;
+    std::vector<typename btree::rb_tree<KeyType>::iterator> positions;
+    for (auto key : keys)
+      tree.insert(make_key(key));
+    for (auto key : bench::shuffled_keys(n, 2))
+      positions.push_back(tree.find(make_key(key)));
+    bench::report(name, n, bench::measure([&] { for (auto position : positions) tree.erase(position); }), n);
+  }
+}
+
+// nodes with two children trade places with their predecessor instead of taking its key,
+// so erasing by iterator costs the same whatever the size of the key
+BENCHMARK(erase_by_iterator)
+{
+  for (auto n : bench::sizes())
+  {
+    erase_all<int>("int keys", n, [](int key) { return key; });
+    erase_all<wide_key>("256 byte keys", n, [](int key) { return wide_key{key, {}}; });
+    erase_all<std::string>("std::string keys", n, [](int key) { return std::string(200, 'x') + std::to_string(key); });
+  }
+}
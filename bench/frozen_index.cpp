@@ -0,0 +1,167 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include "comp/veb_index.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  using wide_key = std::int64_t;
+
+  // the even keys of bench::sorted_keys spread out beyond the range of int
+  std::vector<wide_key> wide_keys(const std::vector<int>& keys)
+  {
+    std::vector<wide_key> result(keys.size());
+    std::transform(keys.begin(), keys.end(), result.begin(), [](int key) { return static_cast<wide_key>(key) << 24; });
+    return result;
+  }
+
+  std::vector<wide_key> lookup_queries(std::size_t n)
+  {
+    auto queries = wide_keys(bench::shuffled_keys(n, 2));
+    for (auto& query : queries)
+      query += query >> 25 & 1;
+    return queries;
+  }
+
+  template <typename Search>
+  void searches(const char* name, std::size_t n, const std::vector<wide_key>& queries, Search search)
+  {
+    bench::report(name, n, bench::measure([&] { for (auto key : queries) bench::keep(search(key)); }), queries.size());
+  }
+
+#if defined(__linux__)
+  // last level cache misses of this thread, -1 when the hardware counters can't be opened (e.g. in a VM)
+  class cache_miss_counter
+  {
+  public:
+    cache_miss_counter()
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    cache_miss_counter(const cache_miss_counter&) = delete;
+    cache_miss_counter& operator=(const cache_miss_counter&) = delete;
+
+    ~cache_miss_counter()
+    {
+      if (m_fd >= 0)
+        close(m_fd);
+    }
+
+    long long read_count() const
+    {
+      long long count = -1;
+      if (m_fd < 0 || read(m_fd, &count, sizeof(count)) != sizeof(count))
+        return -1;
+      return count;
+    }
+
+  private:
+    int m_fd;
+  };
+
+  // page faults and cache misses per lookup, what the layouts differ in once the index leaves the caches
+  template <typename Search>
+  void lookup_costs(const char* name, std::size_t n, const std::vector<wide_key>& queries, Search search)
+  {
+    static cache_miss_counter misses;
+    rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    auto misses_before = misses.read_count();
+    for (auto key : queries)
+      bench::keep(search(key));
+    auto misses_after = misses.read_count();
+    getrusage(RUSAGE_SELF, &after);
+
+    auto per_lookup = [&](long long count) { return static_cast<double>(count) / static_cast<double>(queries.size()); };
+    std::string what = name;
+    bench::report_value(what + " minor faults", n, per_lookup(after.ru_minflt - before.ru_minflt), "per lookup");
+    bench::report_value(what + " major faults", n, per_lookup(after.ru_majflt - before.ru_majflt), "per lookup");
+    if (misses_before >= 0 && misses_after >= 0)
+      bench::report_value(what + " cache misses", n, per_lookup(misses_after - misses_before), "per lookup");
+    else
+      std::printf("  %-44s n=%-10zu %10s\n", (what + " cache misses").c_str(), n, "unavailable");
+  }
+#else
+  template <typename Search>
+  void lookup_costs(const char*, std::size_t, const std::vector<wide_key>&, Search)
+  {
+  }
+#endif
+}
+
+// all searches are O(log n), the frozen layouts differ in how many cache misses each step takes
+BENCHMARK(eytzinger_index)
+{
+  for (auto n : bench::sizes())
+  {
+    auto sorted = wide_keys(bench::sorted_keys(n));
+    btree::rb_tree<wide_key> tree;
+    tree.assign_sorted(sorted.begin(), sorted.end());
+    auto index = tree.freeze();
+    auto queries = lookup_queries(n);
+    searches("rb_tree lower_bound", n, queries, [&](wide_key key) { return tree.lower_bound(key) != tree.end(); });
+    searches("std::lower_bound on sorted vector", n, queries,
+             [&](wide_key key) { return std::lower_bound(sorted.begin(), sorted.end(), key) - sorted.begin(); });
+    searches("eytzinger_index lower_bound", n, queries, [&](wide_key key) { return index.lower_bound(key); });
+  }
+}
+
+// van Emde Boas layout touches O(log_B n) blocks for any block size B, which pays off once the keys leave the caches
+BENCHMARK(veb_index)
+{
+  for (auto n : bench::sizes())
+  {
+    auto sorted = wide_keys(bench::sorted_keys(n));
+    btree::rb_tree<wide_key> tree;
+    tree.assign_sorted(sorted.begin(), sorted.end());
+    auto eytzinger = tree.freeze();
+    auto veb = btree::freeze_veb(tree);
+    auto queries = lookup_queries(n);
+    auto sorted_search = [&](wide_key key) { return std::lower_bound(sorted.begin(), sorted.end(), key) - sorted.begin(); };
+    auto eytzinger_search = [&](wide_key key) { return eytzinger.lower_bound(key); };
+    auto veb_search = [&](wide_key key) { return veb.lower_bound(key); };
+    searches("std::lower_bound on sorted vector", n, queries, sorted_search);
+    searches("eytzinger_index lower_bound", n, queries, eytzinger_search);
+    searches("veb_index lower_bound", n, queries, veb_search);
+
+    // the serialized form as a memory mapped file would hold it, kept in wide_key words for alignment
+    std::ostringstream stream;
+    veb.write(stream);
+    auto bytes = stream.str();
+    std::vector<wide_key> image((bytes.size() + sizeof(wide_key) - 1) / sizeof(wide_key));
+    std::memcpy(image.data(), bytes.data(), bytes.size());
+    std::optional<btree::veb_index_view<wide_key>> view;
+    constexpr std::size_t opens = 1000;
+    bench::report("veb_index_view::from_memory", n, bench::measure([&]
+    {
+      for (std::size_t i = 0; i < opens; ++i)
+        view = btree::veb_index_view<wide_key>::from_memory(image.data(), bytes.size());
+    }), opens);
+    if (!view || view->size() != n)
+      std::printf("  veb_index_view::from_memory rejected the written index\n");
+    else
+      searches("veb_index_view lower_bound from memory", n, queries, [&](wide_key key) { return view->lower_bound(key); });
+
+    lookup_costs("std::lower_bound", n, queries, sorted_search);
+    lookup_costs("eytzinger_index", n, queries, eytzinger_search);
+    lookup_costs("veb_index", n, queries, veb_search);
+  }
+}
@@ -0,0 +1,52 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <string>
+
+namespace
+{
+  template <typename Tree>
+  void insert_erase(const std::string& name, std::size_t n)
+  {
+    auto keys = bench::shuffled_keys(n);
+    Tree tree;
+    bench::report(name + " insert", n, bench::measure([&] { for (auto key : keys) tree.insert(key); }), n);
+    bench::report(name + " erase", n, bench::measure([&] { for (auto key : keys) tree.erase(key); }), n);
+  }
+}
+
+// counters are fixed along the path and in rotated nodes only, so indexed updates stay O(log n)
+BENCHMARK(indexed_updates)
+{
+  for (auto n : bench::sizes())
+  {
+    insert_erase<btree::rb_tree<int>>("rb_tree", n);
+    insert_erase<btree::indexed_rb_tree<int>>("indexed_rb_tree", n);
+  }
+}
+
+// select walks one path by the counters and count_range makes two such walks, both O(log n)
+BENCHMARK(order_statistics)
+{
+  for (auto n : bench::sizes())
+  {
+    auto sorted = bench::sorted_keys(n);
+    btree::indexed_rb_tree<int> tree;
+    tree.assign_sorted(sorted.begin(), sorted.end());
+    auto positions = bench::shuffled_keys(n, 2);
+    bench::report("select", n, bench::measure([&]
+    {
+      for (auto position : positions)
+        bench::keep(*tree.select(static_cast<std::size_t>(position) / 2));
+    }), n);
+    bench::report("count_range", n, bench::measure([&]
+    {
+      for (auto position : positions)
+        bench::keep(tree.count_range(position / 2, position));
+    }), n);
+    bench::report("index", n, bench::measure([&]
+    {
+      for (auto position : positions)
+        bench::keep(tree.index(position));
+    }), n);
+  }
+}
@@ -0,0 +1,79 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <string>
+
+// keys linked next to the hint skip the descent, so appending a sorted run costs amortized O(1) per key
+BENCHMARK(hinted_insertion)
+{
+  for (auto n : bench::sizes())
+  {
+    auto sorted = bench::sorted_keys(n);
+    btree::rb_tree<int> inserted, hinted, appended;
+    bench::report("insert", n, bench::measure([&] { for (auto key : sorted) inserted.insert(key); }), n);
+    bench::report("insert at end()", n, bench::measure([&] { for (auto key : sorted) hinted.insert(hinted.end(), key); }), n);
+    bench::report("append_sorted", n, bench::measure([&] { appended.append_sorted(sorted.begin(), sorted.end()); }), n);
+
+    // odd keys each go right before the even key following them
+    btree::rb_tree<int> gaps;
+    gaps.assign_sorted(sorted.begin(), sorted.end());
+    bench::report("insert before hint", n, bench::measure([&]
+    {
+      for (auto position = gaps.begin(); position != gaps.end(); ++position)
+        gaps.insert(position, *position - 1);
+    }), n);
+  }
+}
+
+namespace
+{
+  // long enough to live on the heap
+  std::string padded_key(int key)
+  {
+    char buffer[48];
+    std::snprintf(buffer, sizeof(buffer), "%040d", key);
+    return buffer;
+  }
+}
+
+// changing keys through node handles reuses both the node and the key storage
+BENCHMARK(node_handles)
+{
+  for (auto n : bench::sizes())
+  {
+    auto keys = bench::shuffled_keys(n);
+    std::vector<std::string> old_keys, new_keys;
+    for (auto key : keys)
+    {
+      old_keys.push_back(padded_key(key));
+      new_keys.push_back(padded_key(key + 1));
+    }
+
+    btree::rb_tree<std::string> erased, extracted;
+    bench::report("insert copy", n, bench::measure([&] { for (auto& key : old_keys) erased.insert(key); }), n);
+    for (auto& key : old_keys)
+      extracted.insert(key);
+
+    // time and operator new calls per rekey
+    auto rekey = [n](const std::string& name, auto&& step)
+    {
+      double seconds = 0;
+      auto allocated = bench::count_allocations([&]
+      {
+        seconds = bench::measure([&] { for (std::size_t i = 0; i < n; ++i) step(i); });
+      });
+      bench::report(name, n, seconds, n);
+      bench::report_value(name + ", allocations", n, static_cast<double>(allocated.first) / static_cast<double>(n), "per op");
+    };
+    rekey("rekey by erase and insert", [&](std::size_t i)
+    {
+      erased.erase(old_keys[i]);
+      erased.insert(new_keys[i]);
+    });
+    rekey("rekey by extract and insert", [&](std::size_t i)
+    {
+      auto handle = extracted.extract(old_keys[i]);
+      handle.key() = new_keys[i];
+      extracted.insert(std::move(handle));
+    });
+  }
+}
@@ -0,0 +1,52 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <utility>
+
+// a query reporting k intervals visits O(min(n, (k + 1) log n)) nodes, a scan visits all n;
+// "toolbox_bench interval 10000000" ends with 10M intervals
+BENCHMARK(interval_queries)
+{
+  using interval_t = std::pair<int, int>;
+  constexpr std::size_t query_count = 1 << 12;
+  constexpr std::size_t scan_count = 1 << 4;
+  for (auto n : bench::sizes())
+  {
+    std::mt19937 generator(1);
+    auto span = static_cast<int>(n) * 10;
+    std::uniform_int_distribution<int> start(0, span), length(1, 100);
+    std::vector<interval_t> intervals(n);
+    for (auto& interval : intervals)
+    {
+      interval.first = start(generator);
+      interval.second = interval.first + length(generator);
+    }
+    std::sort(intervals.begin(), intervals.end());
+    btree::rb_tree_container<interval_t, btree::interval_plugin<int>::type>::tree_t tree;
+    tree.assign_sorted(intervals.begin(), intervals.end());
+
+    std::vector<int> points(query_count);
+    for (auto& point : points)
+      point = start(generator);
+    std::size_t found = 0;
+    auto seconds = bench::measure([&]
+    {
+      for (auto point : points)
+        found += tree.overlapping(point, point + 50).size();
+    });
+    bench::report("overlapping, " + std::to_string(found / query_count) + " found on average", n, seconds, query_count);
+    bench::report("stabbing", n, bench::measure([&] { for (auto point : points) bench::keep(tree.stabbing(point).size()); }), query_count);
+    bench::report("full scan", n, bench::measure([&]
+    {
+      for (std::size_t i = 0; i < scan_count; ++i)
+      {
+        std::size_t count = 0;
+        for (auto& interval : tree)
+          count += !(interval.second < points[i]) && !(points[i] + 50 < interval.first);
+        bench::keep(count);
+      }
+    }), scan_count);
+  }
+}
@@ -0,0 +1,36 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <set>
+
+// every lookup descends one path, O(log n); half of the queried keys are absent
+BENCHMARK(lookup)
+{
+  for (auto n : bench::sizes())
+  {
+    auto keys = bench::shuffled_keys(n);
+    btree::rb_tree<int> tree;
+    std::set<int> reference;
+    for (auto key : keys)
+    {
+      tree.insert(key);
+      reference.insert(key);
+    }
+    auto queries = bench::shuffled_keys(n, 2);
+    for (auto& query : queries)
+      query += query / 2 % 2;
+
+    bench::report("find", n, bench::measure([&] { for (auto key : queries) bench::keep(tree.find(key) != tree.end()); }), n);
+    bench::report("contains", n, bench::measure([&] { for (auto key : queries) bench::keep(tree.contains(key)); }), n);
+    bench::report("lower_bound", n, bench::measure([&] { for (auto key : queries) bench::keep(tree.lower_bound(key) != tree.end()); }), n);
+    bench::report("upper_bound", n, bench::measure([&] { for (auto key : queries) bench::keep(tree.upper_bound(key) != tree.end()); }), n);
+    bench::report("equal_range", n, bench::measure([&]
+    {
+      for (auto key : queries)
+      {
+        auto range = tree.equal_range(key);
+        bench::keep(range.first != range.second);
+      }
+    }), n);
+    bench::report("std::set find", n, bench::measure([&] { for (auto key : queries) bench::keep(reference.find(key) != reference.end()); }), n);
+  }
+}
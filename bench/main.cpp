@@ -0,0 +1,39 @@
+#include "bench.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+void* operator new(std::size_t size)
+{
+  bench::allocations().count.fetch_add(1, std::memory_order_relaxed);
+  bench::allocations().bytes.fetch_add(size, std::memory_order_relaxed);
+  if (auto memory = std::malloc(size ? size : 1))
+    return memory;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
+// usage: toolbox_bench [name filter] [max size]
+int main(int argc, char** argv)
+{
+  const char* filter = argc > 1 ? argv[1] : "";
+  if (argc > 2)
+    bench::max_size() = std::strtoull(argv[2], nullptr, 10);
+
+  for (auto& entry : bench::registry())
+    if (std::strstr(entry.name, filter))
+    {
+      std::printf("%s\n", entry.name);
+      entry.run();
+    }
+  return 0;
+}
@@ -0,0 +1,25 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <utility>
+
+// nothing in the tree points back to it, so moving and swapping take the same time for any size
+BENCHMARK(move_and_swap)
+{
+  constexpr std::size_t repeats = 1 << 16;
+  for (auto n : bench::sizes())
+  {
+    auto sorted = bench::sorted_keys(n);
+    btree::rb_tree<int> tree, other;
+    tree.assign_sorted(sorted.begin(), sorted.end());
+    bench::report("move construct and move back", n, bench::measure([&]
+    {
+      for (std::size_t i = 0; i < repeats; ++i)
+      {
+        btree::rb_tree<int> moved(std::move(tree));
+        tree = std::move(moved);
+      }
+    }), repeats);
+    bench::report("swap", n, bench::measure([&] { for (std::size_t i = 0; i < repeats; ++i) swap(tree, other); }), repeats);
+    bench::keep(tree.size() + other.size());
+  }
+}
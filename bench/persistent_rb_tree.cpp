@@ -0,0 +1,79 @@
+#include "bench.h"
+#include "comp/persistent_rb_tree.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+// updates copy one path of O(log n) nodes, a snapshot only shares the root
+BENCHMARK(persistent_rb_tree)
+{
+  constexpr std::size_t repeats = 1 << 16;
+  for (auto n : bench::sizes())
+  {
+    auto keys = bench::shuffled_keys(n);
+    btree::persistent_rb_tree<int> tree;
+    bench::report("insert", n, bench::measure([&] { for (auto key : keys) tree.insert(key); }), n);
+    bench::report("snapshot", n, bench::measure([&]
+    {
+      for (std::size_t i = 0; i < repeats; ++i)
+        bench::keep(tree.snapshot().size());
+    }), repeats);
+
+    auto snapshot = tree.snapshot();
+    auto queries = bench::shuffled_keys(n, 2);
+    bench::report("snapshot find", n, bench::measure([&] { for (auto key : queries) bench::keep(snapshot.contains(key)); }), n);
+    // the snapshot keeps every original node alive, so erasure only copies paths
+    bench::report("erase while snapshot is held", n, bench::measure([&] { for (auto key : queries) tree.erase(key); }), n);
+    bench::keep(snapshot.size() + tree.size());
+  }
+}
+
+// readers loop over snapshot() and a lookup while one writer keeps inserting and erasing,
+// reads/s should grow with reader threads as long as there are free cores
+BENCHMARK(persistent_rb_tree_readers)
+{
+  constexpr auto duration = std::chrono::milliseconds(200);
+  auto hardware = std::max(std::thread::hardware_concurrency(), 1u);
+  for (auto n : bench::sizes())
+  {
+    auto keys = bench::shuffled_keys(n);
+    btree::persistent_rb_tree<int> tree;
+    for (auto key : keys)
+      tree.insert(key);
+
+    for (unsigned reader_count = 1; reader_count <= std::max(hardware, 4u); reader_count *= 2)
+    {
+      std::atomic<bool> stop {false};
+      std::atomic<std::size_t> reads {0};
+      std::size_t writes = 0;
+      std::vector<std::thread> readers;
+      for (unsigned r = 0; r < reader_count; ++r)
+        readers.emplace_back([&, r]
+        {
+          std::size_t done = 0;
+          for (std::size_t i = r; !stop.load(std::memory_order_relaxed); i += reader_count, ++done)
+            bench::keep(tree.snapshot().contains(keys[i % n]));
+          reads += done;
+        });
+      auto seconds = bench::measure([&]
+      {
+        auto end = std::chrono::steady_clock::now() + duration;
+        // the writer moves keys to odd values and back, so the size stays n
+        for (std::size_t i = 0; std::chrono::steady_clock::now() < end; ++i, writes += 2)
+        {
+          auto key = keys[i % n] + static_cast<int>(i / n % 2);
+          tree.erase(key);
+          tree.insert(key ^ 1);
+        }
+        stop = true;
+        for (auto& reader : readers)
+          reader.join();
+      });
+      auto suffix = ", readers " + std::to_string(reader_count);
+      bench::report_value("snapshot and find" + suffix, n, static_cast<double>(reads) / seconds / 1e3, "K reads/s");
+      bench::report_value("concurrent writer" + suffix, n, static_cast<double>(writes) / seconds / 1e3, "K writes/s");
+    }
+  }
+}
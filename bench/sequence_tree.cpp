@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "comp/sequence_tree.h"
+#include <deque>
+#include <random>
+#include <string>
+
+// positional operations take O(log n) where std::vector moves O(n) elements
+BENCHMARK(sequence_tree)
+{
+  constexpr std::size_t repeats = 1 << 12;
+  for (auto n : bench::sizes())
+  {
+    std::mt19937 generator(1);
+    std::vector<std::size_t> positions(n);
+    for (std::size_t i = 0; i < n; ++i)
+      positions[i] = std::uniform_int_distribution<std::size_t>(0, i)(generator);
+
+    btree::sequence_tree<int> sequence;
+    bench::report("insert_at", n, bench::measure([&]
+    {
+      for (std::size_t i = 0; i < n; ++i)
+        sequence.insert_at(positions[i], static_cast<int>(i));
+    }), n);
+    bench::report("at", n, bench::measure([&] { for (std::size_t i = 0; i < n; ++i) bench::keep(sequence.at(positions[i])); }), n);
+    bench::report("split_at and concat", n, bench::measure([&]
+    {
+      btree::sequence_tree<int> tail;
+      for (std::size_t i = 0; i < repeats; ++i)
+      {
+        sequence.split_at(positions[n - 1 - i % n], tail);
+        sequence.concat(tail);
+      }
+    }), repeats);
+    bench::report("erase_at", n, bench::measure([&] { for (std::size_t i = n; i-- > 0;) sequence.erase_at(positions[i]); }), n);
+
+    // the standard containers shift O(n) elements, std::deque only the shorter side, so they stop at 128K
+    if (n <= (std::size_t(1) << 17))
+    {
+      auto baseline = [&](const std::string& name, auto container)
+      {
+        bench::report(name + " insert", n, bench::measure([&]
+        {
+          for (std::size_t i = 0; i < n; ++i)
+            container.insert(container.begin() + static_cast<std::ptrdiff_t>(positions[i]), static_cast<int>(i));
+        }), n);
+        bench::report(name + " erase", n, bench::measure([&]
+        {
+          for (std::size_t i = n; i-- > 0;)
+            container.erase(container.begin() + static_cast<std::ptrdiff_t>(positions[i]));
+        }), n);
+      };
+      baseline("std::vector", std::vector<int>());
+      baseline("std::deque", std::deque<int>());
+    }
+  }
+}
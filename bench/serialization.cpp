@@ -0,0 +1,26 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <sstream>
+#include <string>
+
+// writing and loading back are O(n), the loaded tree is rebuilt balanced without comparisons
+BENCHMARK(serialization)
+{
+  for (auto n : bench::sizes())
+  {
+    auto keys = bench::shuffled_keys(n);
+    btree::rb_tree<int> tree;
+    for (auto key : keys)
+      tree.insert(key);
+
+    std::ostringstream stream;
+    bench::report("write", n, bench::measure([&] { tree.write(stream); }), n);
+    auto data = stream.str();
+
+    btree::rb_tree<int> from_memory, from_stream, inserted;
+    bench::report("load from memory", n, bench::measure([&] { bench::keep(from_memory.load(data.data(), data.size())); }), n);
+    std::istringstream input(data);
+    bench::report("load from stream", n, bench::measure([&] { bench::keep(from_stream.load(input)); }), n);
+    bench::report("insert one by one", n, bench::measure([&] { for (auto key : keys) inserted.insert(key); }), n);
+  }
+}
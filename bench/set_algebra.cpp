@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "comp/btree.h"
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <type_traits>
+
+namespace
+{
+  using tree_t = btree::rb_tree<int>;
+
+  // tree with n even keys and one with n / step keys spread over the same range, half of which are in both
+  std::size_t make_operands(std::size_t n, std::size_t step, tree_t& lhs, tree_t& rhs)
+  {
+    auto even = bench::sorted_keys(n);
+    lhs.assign_sorted(even.begin(), even.end());
+    std::vector<int> keys;
+    for (std::size_t i = 0; i < n / step; ++i)
+      keys.push_back(static_cast<int>(2 * step * i + i % 2));
+    rhs.assign_sorted(keys.begin(), keys.end());
+    return keys.size();
+  }
+
+  // operation may return the seconds it measured itself to leave its preparation out
+  template <typename Operation>
+  void run(const std::string& name, std::size_t n, std::size_t step, Operation operation)
+  {
+    tree_t lhs, rhs;
+    auto m = make_operands(n, step, lhs, rhs);
+    double seconds = 0;
+    auto total = bench::measure([&]
+    {
+      if constexpr (std::is_same<decltype(operation(lhs, rhs)), double>::value)
+        seconds = operation(lhs, rhs);
+      else
+        operation(lhs, rhs);
+    });
+    bench::report(name, n, seconds ? seconds : total, m);
+  }
+}
+
+// join based union and difference take O(m log(n / m + 1)) for m keys in the smaller tree,
+// so their time per key of it stays flat for fixed n / m while inserting those keys one by one
+// costs O(log n) each; intersection_of keeps the result in the larger tree and destroys its other nodes in O(n)
+BENCHMARK(set_algebra)
+{
+  for (auto n : bench::sizes())
+  {
+    for (std::size_t step : {std::size_t(1), std::size_t(1) << 10})
+    {
+      auto suffix = ", m=n/" + std::to_string(step);
+      // rb_tree keeps equal keys, so the baseline has to skip the shared ones to compute a union
+      run("insert absent one by one" + suffix, n, step, [](tree_t& lhs, tree_t& rhs)
+      {
+        for (auto key : rhs)
+          if (!lhs.contains(key))
+            lhs.insert(key);
+      });
+      run("std::set_union of sorted vectors" + suffix, n, step, [](tree_t& lhs, tree_t& rhs)
+      {
+        std::vector<int> lhs_keys(lhs.begin(), lhs.end()), rhs_keys(rhs.begin(), rhs.end()), result;
+        result.reserve(lhs_keys.size() + rhs_keys.size());
+        auto seconds = bench::measure([&]
+        {
+          std::set_union(lhs_keys.begin(), lhs_keys.end(), rhs_keys.begin(), rhs_keys.end(), std::back_inserter(result));
+        });
+        return seconds;
+      });
+      run("union_of, thread_count 1" + suffix, n, step, [](tree_t& lhs, tree_t& rhs) { lhs.union_of(rhs, 1); });
+      run("union_of" + suffix, n, step, [](tree_t& lhs, tree_t& rhs) { lhs.union_of(rhs); });
+      run("intersection_of" + suffix, n, step, [](tree_t& lhs, tree_t& rhs) { lhs.intersection_of(rhs); });
+      run("difference_of" + suffix, n, step, [](tree_t& lhs, tree_t& rhs) { lhs.difference_of(rhs); });
+    }
+  }
+}
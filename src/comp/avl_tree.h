@@ -0,0 +1,209 @@
+#pragma once
+#include "comp/btree.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+namespace btree
+{
+  // AVL tree on the same core as rb_tree_container, heights of sibling subtrees differ at most by one,
+  // so lookups are shorter than in red black tree at the price of more rotations on updates
+  template <typename KeyType, template<typename> class... Plugins>
+  struct avl_tree_container
+  {
+    class tree_t;
+
+    struct node_t : btree_container<KeyType, node_t, Plugins...>::node_t
+    {
+      using parent_t = typename btree_container<KeyType, node_t, Plugins...>::node_t;
+      using parent_t::parent_t;
+    public:
+      // direction of the higher child subtree, none if both have the same height
+      direction_t heavy() const { return static_cast<direction_t>(static_cast<int>(this->parent_tag()) - 1); }
+
+    private:
+      // balance is stored in the parent pointer, new nodes are balanced
+      void set_heavy(direction_t direction) { this->set_parent_tag(static_cast<unsigned>(direction + 1)); }
+
+      friend class tree_t;
+    };
+
+    class tree_t : public btree_container<KeyType, typename avl_tree_container::node_t, Plugins...>::tree_t
+    {
+      using self = tree_t;
+      using base = typename btree_container<KeyType, typename avl_tree_container::node_t, Plugins...>::tree_t;
+    public:
+      using node_t = typename avl_tree_container::node_t;
+
+      tree_t () : base () {}
+      ~tree_t () {}
+
+      tree_t (const tree_t &) = default;
+      tree_t &operator= (const tree_t &) = default;
+      tree_t (tree_t &&) noexcept = default;
+      tree_t &operator= (tree_t &&) noexcept = default;
+
+      friend void swap (tree_t &lhs, tree_t &rhs) noexcept { lhs.swap (rhs); }
+
+      // [first, last) has to be sorted, builds the tree in O(n) without rebalancing
+      template <typename ForwardIt>
+      void assign_sorted(ForwardIt first, ForwardIt last)
+      {
+        this->build_sorted(first, last, [](node_t*, int) {});
+        assign_balance(this->root());
+      }
+
+      template <typename ArgType>
+      void insert(ArgType&& key)
+      {
+        fix_after_insert(this->preinsert(std::forward<ArgType>(key)));
+      }
+
+      // inserts key as close as possible before hint, in amortized O(1) if it belongs right there
+      template <typename ArgType>
+      typename base::iterator insert(typename base::iterator hint, ArgType&& key)
+      {
+        auto node = this->preinsert(hint, std::forward<ArgType>(key));
+        fix_after_insert(node);
+        return {node};
+      }
+
+      // constructs the key in a new node from args
+      template <typename... ArgTypes>
+      typename base::iterator emplace(ArgTypes&&... args)
+      {
+        auto node = this->link_node(this->create_node(std::forward<ArgTypes>(args)...));
+        fix_after_insert(node);
+        return {node};
+      }
+
+      template <typename ArgType>
+      std::size_t erase(const ArgType& key)
+      {
+        auto node = this->preerase(key);
+        if (!node)
+          return 0;
+
+        unlink(node);
+        this->destroy_node(node);
+        return 1;
+      }
+
+      // returns iterator following the erased key, iterators to other keys stay valid
+      typename base::iterator erase(typename base::iterator position)
+      {
+        auto next = position;
+        ++next;
+        auto node = this->preerase_node(base::node_of(position));
+        unlink(node);
+        this->destroy_node(node);
+        return next;
+      }
+
+      typename base::iterator erase(typename base::iterator first, typename base::iterator last)
+      {
+        while (first != last)
+          first = erase(first);
+        return last;
+      }
+
+    private:
+      // sets balances of a freshly built subtree bottom-up, returns its height
+      static int assign_balance(node_t* node)
+      {
+        if (!node)
+          return 0;
+
+        int heights[2];
+        for (auto direction : {left, right})
+          heights[direction] = assign_balance(node->child(direction));
+        node->set_heavy(heights[left] == heights[right] ? none : heights[left] > heights[right] ? left : right);
+        return std::max(heights[left], heights[right]) + 1;
+      }
+
+      // fixes subtree of node whose child in direction has become higher by two,
+      // returns the new root of the subtree and whether its height has decreased
+      std::pair<node_t*, bool> rebalance(node_t* node, direction_t direction)
+      {
+        auto child = node->child(direction);
+        auto opposite = other_direction(direction);
+        if (child->heavy() == opposite)
+        {
+          auto grand_child = child->child(opposite);
+          this->rotate(child, direction);
+          this->rotate(node, opposite);
+          auto grand_child_heavy = grand_child->heavy();
+          node->set_heavy(grand_child_heavy == direction ? opposite : none);
+          child->set_heavy(grand_child_heavy == opposite ? direction : none);
+          grand_child->set_heavy(none);
+          return {grand_child, true};
+        }
+
+        this->rotate(node, opposite);
+        if (child->heavy() == none)
+        {
+          // happens only on erase, height of the subtree stays the same
+          node->set_heavy(direction);
+          child->set_heavy(opposite);
+          return {child, false};
+        }
+        node->set_heavy(none);
+        child->set_heavy(none);
+        return {child, true};
+      }
+
+      // restores balance after a leaf was linked
+      void fix_after_insert(node_t* current)
+      {
+        for (auto parent = current->parent(); parent; current = parent, parent = parent->parent())
+        {
+          auto direction = current->direction_from_parent();
+          if (parent->heavy() == none)
+          {
+            parent->set_heavy(direction);
+            continue;
+          }
+          if (parent->heavy() != direction)
+            parent->set_heavy(none);
+          else
+            rebalance(parent, direction);
+          return;
+        }
+      }
+
+      // unlinks node with at most one child keeping the tree balanced, node isn't destroyed
+      void unlink(node_t* node)
+      {
+        auto parent = node->parent();
+        auto direction = node->direction_from_parent();
+        this->replace_with_child(node);
+        // subtree of parent in direction has become lower by one
+        while (parent)
+        {
+          if (parent->heavy() == none)
+          {
+            parent->set_heavy(other_direction(direction));
+            return;
+          }
+          if (parent->heavy() == direction)
+            parent->set_heavy(none);
+          else
+          {
+            auto fixed = rebalance(parent, other_direction(direction));
+            if (!fixed.second)
+              return;
+            parent = fixed.first;
+          }
+          direction = parent->direction_from_parent();
+          parent = parent->parent();
+        }
+      }
+    };
+  };
+
+  template <typename KeyType>
+  using avl_tree = typename avl_tree_container<KeyType>::tree_t;
+  template <typename KeyType>
+  using indexed_avl_tree = typename avl_tree_container<KeyType, indexation_plugin>::tree_t;
+} // namespace btree
@@ -0,0 +1,594 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+
+namespace btree
+{
+  // Plugins have the same shape as for btree_container: Plugin<NodeType>::node_t is a base of every node
+  // and Plugin<NodeType>::template tree_t<TreeType> is a base of the tree.
+  // Instead of binary tree hooks node_t has to provide recalculate() which recomputes plugin data
+  // from node keys (leaf) or children (inner node), it's called bottom-up for every changed node.
+  template <typename KeyType, template <typename> class... Plugins>
+  struct bplus_tree_container
+  {
+    // nodes are sized to fit into few cache lines, KeyType has to be default constructible
+    static constexpr std::size_t node_bytes = 256;
+
+    class node_t;
+    class leaf_t;
+    class inner_t;
+    class iterator_t;
+    class tree_t;
+
+    class node_t : public Plugins<node_t>::node_t...
+    {
+    public:
+      bool is_leaf() const { return m_is_leaf; }
+      // keys for leaf, children for inner node
+      std::size_t size() const { return m_count; }
+
+      const inner_t* parent() const { return m_parent; }
+
+      const leaf_t* as_leaf() const
+      {
+        assert (m_is_leaf);
+        return static_cast<const leaf_t *>(this);
+      }
+
+      const inner_t* as_inner() const
+      {
+        assert (!m_is_leaf);
+        return static_cast<const inner_t *>(this);
+      }
+
+    protected:
+      explicit node_t(bool is_leaf) : m_is_leaf(is_leaf) {}
+
+    private:
+      inner_t* m_parent = nullptr;
+      std::size_t m_count = 0;
+      bool m_is_leaf;
+
+      friend class tree_t;
+    };
+
+    class leaf_t : public node_t
+    {
+      static constexpr std::size_t fitting_keys = node_bytes > sizeof(node_t) + 2 * sizeof(void *)
+        ? (node_bytes - sizeof(node_t) - 2 * sizeof(void *)) / sizeof(KeyType) : 0;
+
+    public:
+      static constexpr std::size_t capacity = std::max<std::size_t>(fitting_keys, 3);
+      static constexpr std::size_t min_size = capacity / 2;
+
+      leaf_t() : node_t(true) {}
+
+      const KeyType& key(std::size_t i) const { return m_keys[i]; }
+      const leaf_t* next() const { return m_next; }
+      const leaf_t* prev() const { return m_prev; }
+
+      template <typename ArgType>
+      std::size_t lower_bound_position(const ArgType& key) const
+      {
+        return std::lower_bound(m_keys.begin(), m_keys.begin() + this->size(), key) - m_keys.begin();
+      }
+
+    private:
+      std::array<KeyType, capacity> m_keys;
+      leaf_t* m_next = nullptr;
+      leaf_t* m_prev = nullptr;
+
+      friend class tree_t;
+    };
+
+    class inner_t : public node_t
+    {
+      static constexpr std::size_t fitting_children = node_bytes > sizeof(node_t)
+        ? (node_bytes - sizeof(node_t)) / (sizeof(KeyType) + sizeof(void *)) : 0;
+
+    public:
+      // in children
+      static constexpr std::size_t capacity = std::max<std::size_t>(fitting_children, 4);
+      static constexpr std::size_t min_size = capacity / 2;
+
+      inner_t() : node_t(false) {}
+
+      // key(i) is the smallest key of child(i + 1) subtree at the moment of split,
+      // all keys of child(i) are less than key(i) and all keys of child(i + 1) are not less
+      const KeyType& key(std::size_t i) const { return m_keys[i]; }
+      const node_t* child(std::size_t i) const { return m_children[i]; }
+
+      template <typename ArgType>
+      std::size_t child_position(const ArgType& key) const
+      {
+        return std::upper_bound(m_keys.begin(), m_keys.begin() + (this->size() - 1), key) - m_keys.begin();
+      }
+
+    private:
+      std::array<KeyType, capacity - 1> m_keys;
+      std::array<node_t*, capacity> m_children;
+
+      friend class tree_t;
+    };
+
+    class iterator_t
+    {
+      using self = iterator_t;
+    public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using reference = const KeyType &;
+      using pointer = const KeyType *;
+      using value_type = const KeyType;
+      using difference_type = std::ptrdiff_t;
+
+    public:
+      iterator_t(const tree_t* tree, const leaf_t* leaf, std::size_t position) : m_tree(tree), m_leaf(leaf), m_position(position) {}
+
+      self& operator++()
+      {
+        if (++m_position == m_leaf->size())
+        {
+          m_leaf = m_leaf->next();
+          m_position = 0;
+        }
+        return *this;
+      }
+
+      self& operator--()
+      {
+        if (!m_leaf)
+        {
+          m_leaf = m_tree->m_last_leaf;
+          m_position = m_leaf->size();
+        }
+        else if (m_position == 0)
+        {
+          m_leaf = m_leaf->prev();
+          m_position = m_leaf->size();
+        }
+        --m_position;
+        return *this;
+      }
+
+      reference operator*() const { return m_leaf->key(m_position); }
+      pointer operator->() const { return &m_leaf->key(m_position); }
+
+      bool operator==(const self& other) const
+      {
+        return m_leaf == other.m_leaf && m_position == other.m_position;
+      }
+
+      bool operator!=(const self& other) const
+      {
+        return !(*this == other);
+      }
+
+    private:
+      const tree_t* m_tree;
+      const leaf_t* m_leaf;
+      std::size_t m_position;
+    };
+
+    class tree_t : public Plugins<typename bplus_tree_container::node_t>::template tree_t<tree_t>...
+    {
+      using self = tree_t;
+    public:
+      using iterator = iterator_t;
+      using node_t = typename bplus_tree_container::node_t;
+      using leaf_t = typename bplus_tree_container::leaf_t;
+      using inner_t = typename bplus_tree_container::inner_t;
+
+    public:
+      tree_t() = default;
+      tree_t(const tree_t&) = delete;
+      tree_t& operator=(const tree_t&) = delete;
+      ~tree_t() { clear(); }
+
+      iterator_t begin() const { return {this, m_first_leaf, 0}; }
+      iterator_t end() const { return {this, nullptr, 0}; }
+
+      std::size_t size() const { return m_size; }
+      const node_t* root() const { return m_root; }
+
+      void clear()
+      {
+        destroy_subtree(m_root);
+        m_root = nullptr;
+        m_first_leaf = m_last_leaf = nullptr;
+        m_size = 0;
+      }
+
+      template <typename ArgType>
+      iterator_t find(const ArgType& key) const
+      {
+        if (!m_root)
+          return end();
+        auto leaf = find_leaf(key);
+        auto position = leaf->lower_bound_position(key);
+        if (position == leaf->size() || key < leaf->m_keys[position])
+          return end();
+        return {this, leaf, position};
+      }
+
+      // returns false if key is already present
+      template <typename ArgType>
+      bool insert(ArgType&& key)
+      {
+        if (!m_root)
+          m_root = m_first_leaf = m_last_leaf = new leaf_t;
+
+        auto leaf = find_leaf(key);
+        auto position = leaf->lower_bound_position(key);
+        if (position < leaf->size() && !(key < leaf->m_keys[position]))
+          return false;
+
+        if (leaf->size() == leaf_t::capacity)
+        {
+          auto new_leaf = split_leaf(leaf);
+          if (position > leaf->size())
+          {
+            position -= leaf->size();
+            leaf = new_leaf;
+          }
+        }
+
+        std::move_backward(leaf->m_keys.begin() + position, leaf->m_keys.begin() + leaf->m_count, leaf->m_keys.begin() + leaf->m_count + 1);
+        leaf->m_keys[position] = std::forward<ArgType>(key);
+        ++leaf->m_count;
+        ++m_size;
+        recalculate_upwards(leaf);
+        return true;
+      }
+
+      template <typename ArgType>
+      std::size_t erase(const ArgType& key)
+      {
+        if (!m_root)
+          return 0;
+
+        auto leaf = find_leaf(key);
+        auto position = leaf->lower_bound_position(key);
+        if (position == leaf->size() || key < leaf->m_keys[position])
+          return 0;
+
+        std::move(leaf->m_keys.begin() + position + 1, leaf->m_keys.begin() + leaf->m_count, leaf->m_keys.begin() + position);
+        --leaf->m_count;
+        --m_size;
+
+        if (leaf == m_root)
+        {
+          if (leaf->m_count == 0)
+            clear();
+          else
+            recalculate(leaf);
+          return 1;
+        }
+
+        recalculate_upwards(rebalance_leaf(leaf));
+        return 1;
+      }
+
+    private:
+      template <typename ArgType>
+      leaf_t* find_leaf(const ArgType& key) const
+      {
+        auto node = m_root;
+        while (!node->is_leaf())
+        {
+          auto inner = static_cast<inner_t *>(node);
+          node = inner->m_children[inner->child_position(key)];
+        }
+        return static_cast<leaf_t *>(node);
+      }
+
+      static std::size_t position_in_parent(const node_t* node)
+      {
+        auto parent = node->m_parent;
+        return std::find(parent->m_children.begin(), parent->m_children.begin() + parent->m_count, node) - parent->m_children.begin();
+      }
+
+      static void recalculate([[maybe_unused]] node_t* node)
+      {
+        std::initializer_list<int>{(static_cast<typename Plugins<node_t>::node_t *>(node)->recalculate(), 0)...};
+      }
+
+      static void recalculate_upwards(node_t* node)
+      {
+        if (sizeof...(Plugins) == 0)
+          return;
+        for (; node; node = node->m_parent)
+          recalculate(node);
+      }
+
+      // moves upper half of full leaf to the new right sibling
+      leaf_t* split_leaf(leaf_t* leaf)
+      {
+        auto new_leaf = new leaf_t;
+        auto keep = leaf->m_count - leaf->m_count / 2;
+        std::move(leaf->m_keys.begin() + keep, leaf->m_keys.begin() + leaf->m_count, new_leaf->m_keys.begin());
+        new_leaf->m_count = leaf->m_count - keep;
+        leaf->m_count = keep;
+
+        new_leaf->m_next = leaf->m_next;
+        new_leaf->m_prev = leaf;
+        if (leaf->m_next)
+          leaf->m_next->m_prev = new_leaf;
+        else
+          m_last_leaf = new_leaf;
+        leaf->m_next = new_leaf;
+
+        recalculate(leaf);
+        recalculate(new_leaf);
+        insert_into_parent(leaf, new_leaf->m_keys[0], new_leaf);
+        return new_leaf;
+      }
+
+      // moves upper half of full inner node to the new right sibling, returns it together with separator between them
+      std::pair<inner_t*, KeyType> split_inner(inner_t* inner)
+      {
+        auto new_inner = new inner_t;
+        auto keep = inner->m_count - inner->m_count / 2;
+        KeyType separator = std::move(inner->m_keys[keep - 1]);
+        std::move(inner->m_keys.begin() + keep, inner->m_keys.begin() + (inner->m_count - 1), new_inner->m_keys.begin());
+        std::copy(inner->m_children.begin() + keep, inner->m_children.begin() + inner->m_count, new_inner->m_children.begin());
+        new_inner->m_count = inner->m_count - keep;
+        inner->m_count = keep;
+        for (std::size_t i = 0; i < new_inner->m_count; ++i)
+          new_inner->m_children[i]->m_parent = new_inner;
+
+        recalculate(inner);
+        recalculate(new_inner);
+        return {new_inner, std::move(separator)};
+      }
+
+      // inserts right_node just after left_node into its parent
+      void insert_into_parent(node_t* left_node, const KeyType& separator, node_t* right_node)
+      {
+        auto parent = left_node->m_parent;
+        if (!parent)
+        {
+          auto root = new inner_t;
+          root->m_keys[0] = separator;
+          root->m_children[0] = left_node;
+          root->m_children[1] = right_node;
+          root->m_count = 2;
+          left_node->m_parent = right_node->m_parent = root;
+          m_root = root;
+          return;
+        }
+
+        if (parent->m_count == inner_t::capacity)
+        {
+          auto split = split_inner(parent);
+          insert_into_parent(parent, split.second, split.first);
+          parent = left_node->m_parent;
+        }
+
+        auto position = position_in_parent(left_node);
+        std::move_backward(parent->m_keys.begin() + position, parent->m_keys.begin() + (parent->m_count - 1), parent->m_keys.begin() + parent->m_count);
+        std::copy_backward(parent->m_children.begin() + position + 1, parent->m_children.begin() + parent->m_count, parent->m_children.begin() + parent->m_count + 1);
+        parent->m_keys[position] = separator;
+        parent->m_children[position + 1] = right_node;
+        right_node->m_parent = parent;
+        ++parent->m_count;
+      }
+
+      // removes child at position together with the separator on the left of it (or on the right for the first child)
+      static void remove_child(inner_t* parent, std::size_t position)
+      {
+        auto key_position = position == 0 ? 0 : position - 1;
+        std::move(parent->m_keys.begin() + key_position + 1, parent->m_keys.begin() + (parent->m_count - 1), parent->m_keys.begin() + key_position);
+        std::copy(parent->m_children.begin() + position + 1, parent->m_children.begin() + parent->m_count, parent->m_children.begin() + position);
+        --parent->m_count;
+      }
+
+      // fixes underflow of non-root leaf, returns the leaf where its keys ended up
+      leaf_t* rebalance_leaf(leaf_t* leaf)
+      {
+        if (leaf->m_count >= leaf_t::min_size)
+          return leaf;
+
+        auto parent = leaf->m_parent;
+        auto position = position_in_parent(leaf);
+        auto left_sibling = position > 0 ? static_cast<leaf_t *>(parent->m_children[position - 1]) : nullptr;
+        auto right_sibling = position + 1 < parent->m_count ? static_cast<leaf_t *>(parent->m_children[position + 1]) : nullptr;
+
+        if (left_sibling && left_sibling->m_count > leaf_t::min_size)
+        {
+          std::move_backward(leaf->m_keys.begin(), leaf->m_keys.begin() + leaf->m_count, leaf->m_keys.begin() + leaf->m_count + 1);
+          leaf->m_keys[0] = std::move(left_sibling->m_keys[--left_sibling->m_count]);
+          ++leaf->m_count;
+          parent->m_keys[position - 1] = leaf->m_keys[0];
+          recalculate(left_sibling);
+          recalculate(leaf);
+          return leaf;
+        }
+
+        if (right_sibling && right_sibling->m_count > leaf_t::min_size)
+        {
+          leaf->m_keys[leaf->m_count++] = std::move(right_sibling->m_keys[0]);
+          std::move(right_sibling->m_keys.begin() + 1, right_sibling->m_keys.begin() + right_sibling->m_count, right_sibling->m_keys.begin());
+          --right_sibling->m_count;
+          parent->m_keys[position] = right_sibling->m_keys[0];
+          recalculate(right_sibling);
+          recalculate(leaf);
+          return leaf;
+        }
+
+        auto merged = left_sibling ? left_sibling : leaf;
+        auto removed = left_sibling ? leaf : right_sibling;
+        std::move(removed->m_keys.begin(), removed->m_keys.begin() + removed->m_count, merged->m_keys.begin() + merged->m_count);
+        merged->m_count += removed->m_count;
+        merged->m_next = removed->m_next;
+        if (removed->m_next)
+          removed->m_next->m_prev = merged;
+        else
+          m_last_leaf = merged;
+        remove_child(parent, position_in_parent(removed));
+        delete removed;
+        recalculate(merged);
+        rebalance_inner(parent);
+        return merged;
+      }
+
+      void rebalance_inner(inner_t* inner)
+      {
+        if (inner == m_root)
+        {
+          if (inner->m_count == 1)
+          {
+            m_root = inner->m_children[0];
+            m_root->m_parent = nullptr;
+            delete inner;
+          }
+          else
+            recalculate(inner);
+          return;
+        }
+
+        if (inner->m_count >= inner_t::min_size)
+        {
+          recalculate(inner);
+          return;
+        }
+
+        auto parent = inner->m_parent;
+        auto position = position_in_parent(inner);
+        auto left_sibling = position > 0 ? static_cast<inner_t *>(parent->m_children[position - 1]) : nullptr;
+        auto right_sibling = position + 1 < parent->m_count ? static_cast<inner_t *>(parent->m_children[position + 1]) : nullptr;
+
+        if (left_sibling && left_sibling->m_count > inner_t::min_size)
+        {
+          std::move_backward(inner->m_keys.begin(), inner->m_keys.begin() + (inner->m_count - 1), inner->m_keys.begin() + inner->m_count);
+          std::copy_backward(inner->m_children.begin(), inner->m_children.begin() + inner->m_count, inner->m_children.begin() + inner->m_count + 1);
+          inner->m_keys[0] = std::move(parent->m_keys[position - 1]);
+          inner->m_children[0] = left_sibling->m_children[left_sibling->m_count - 1];
+          inner->m_children[0]->m_parent = inner;
+          ++inner->m_count;
+          parent->m_keys[position - 1] = std::move(left_sibling->m_keys[left_sibling->m_count - 2]);
+          --left_sibling->m_count;
+          recalculate(left_sibling);
+          recalculate(inner);
+          return;
+        }
+
+        if (right_sibling && right_sibling->m_count > inner_t::min_size)
+        {
+          inner->m_keys[inner->m_count - 1] = std::move(parent->m_keys[position]);
+          inner->m_children[inner->m_count] = right_sibling->m_children[0];
+          inner->m_children[inner->m_count]->m_parent = inner;
+          ++inner->m_count;
+          parent->m_keys[position] = std::move(right_sibling->m_keys[0]);
+          remove_child(right_sibling, 0);
+          recalculate(right_sibling);
+          recalculate(inner);
+          return;
+        }
+
+        auto merged = left_sibling ? left_sibling : inner;
+        auto removed = left_sibling ? inner : right_sibling;
+        auto removed_position = position_in_parent(removed);
+        merged->m_keys[merged->m_count - 1] = std::move(parent->m_keys[removed_position - 1]);
+        std::move(removed->m_keys.begin(), removed->m_keys.begin() + (removed->m_count - 1), merged->m_keys.begin() + merged->m_count);
+        std::copy(removed->m_children.begin(), removed->m_children.begin() + removed->m_count, merged->m_children.begin() + merged->m_count);
+        for (std::size_t i = 0; i < removed->m_count; ++i)
+          removed->m_children[i]->m_parent = merged;
+        merged->m_count += removed->m_count;
+        remove_child(parent, removed_position);
+        delete removed;
+        recalculate(merged);
+        rebalance_inner(parent);
+      }
+
+      static void destroy_subtree(node_t* node)
+      {
+        if (!node)
+          return;
+        if (node->is_leaf())
+        {
+          delete static_cast<leaf_t *>(node);
+          return;
+        }
+        auto inner = static_cast<inner_t *>(node);
+        for (std::size_t i = 0; i < inner->m_count; ++i)
+          destroy_subtree(inner->m_children[i]);
+        delete inner;
+      }
+
+    private:
+      node_t* m_root = nullptr;
+      leaf_t* m_first_leaf = nullptr;
+      leaf_t* m_last_leaf = nullptr;
+      std::size_t m_size = 0;
+
+      friend class iterator_t;
+    };
+  };
+
+  // order statistics for bplus_tree_container, same interface as indexation_plugin
+  template <typename NodeType>
+  class bplus_indexation_plugin
+  {
+  public:
+    class node_t
+    {
+    public:
+      std::size_t node_count() const { return m_node_count; }
+
+      void recalculate()
+      {
+        auto node = static_cast<const NodeType *>(this);
+        if (node->is_leaf())
+        {
+          m_node_count = node->size();
+          return;
+        }
+        m_node_count = 0;
+        auto inner = node->as_inner();
+        for (std::size_t i = 0; i < inner->size(); ++i)
+          m_node_count += inner->child(i)->node_count();
+      }
+
+    private:
+      std::size_t m_node_count = 0;
+    };
+
+    template <typename TreeType>
+    class tree_t
+    {
+    public:
+      template <typename ArgType>
+      std::size_t index(const ArgType& key) const
+      {
+        const NodeType* current = static_cast<const TreeType *>(this)->root();
+        if (!current)
+          return static_cast<std::size_t>(-1);
+
+        std::size_t index_so_far = 0;
+        while (!current->is_leaf())
+        {
+          auto inner = current->as_inner();
+          auto position = inner->child_position(key);
+          for (std::size_t i = 0; i < position; ++i)
+            index_so_far += inner->child(i)->node_count();
+          current = inner->child(position);
+        }
+        auto leaf = current->as_leaf();
+        auto position = leaf->lower_bound_position(key);
+        if (position == leaf->size() || key < leaf->key(position))
+          return static_cast<std::size_t>(-1);
+        return index_so_far + position;
+      }
+    };
+  };
+
+  template <typename KeyType>
+  using bplus_tree = typename bplus_tree_container<KeyType>::tree_t;
+  template <typename KeyType>
+  using indexed_bplus_tree = typename bplus_tree_container<KeyType, bplus_indexation_plugin>::tree_t;
+} // namespace btree
@@ -4,6 +4,19 @@
 #include <cassert>
 #include <array>
 #include <iterator>
+#include <vector>
+#include <type_traits>
+#include <algorithm>
+#include <new>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <utility>
+#include <optional>
+#include <atomic>
+#include <cstring>
+#include <istream>
+#include <ostream>
 namespace btree
 {
   enum class color_t : char
@@ -24,6 +37,20 @@ namespace btree
     return d == left ? right : left;
   }
 
+  // events reported to plugins whose tree_t has on_event(tree_event, std::size_t) const,
+  // value is the depth of inserted node for insertion and the number of events otherwise
+  enum class tree_event
+  {
+    comparison,
+    rotation,
+    recoloring,
+    allocation,
+    deallocation,
+    insertion,
+    erasure,
+    lookup,
+  };
+
   template <typename KeyType, template <typename> class... Plugins>
   struct rb_tree_container;
 
@@ -31,38 +58,431 @@ namespace btree
   struct btree_container;
 
   template <typename NodeType>
-  class indexation_plugin
+  class heap_node_allocator
+  {
+  public:
+    template <typename... ArgTypes>
+    NodeType* create(ArgTypes&&... args) { return new NodeType(std::forward<ArgTypes>(args)...); }
+    void destroy(NodeType* node) { delete node; }
+
+    // every node has to be destroyed separately before release()
+    static constexpr bool releases_in_bulk = false;
+    // nodes may be handed over to another allocator of the same type
+    static constexpr bool transferable_nodes = true;
+    void release() {}
+    void hand_out() {}
+    void take_back() {}
+    std::size_t handed_out() const { return 0; }
+    void adopt(heap_node_allocator&&) {}
+    void reserve(std::size_t) {}
+    void swap(heap_node_allocator&) noexcept {}
+  };
+
+  // slab allocator, erased nodes are recycled through intrusive free list
+  // and release() frees everything in O(number of slabs)
+  template <typename NodeType>
+  class node_pool
+  {
+    union slot_t
+    {
+      slot_t* next_free;
+      alignas(NodeType) unsigned char storage[sizeof(NodeType)];
+    };
+    static constexpr std::size_t first_slab_size = 16;
+    static constexpr std::size_t max_slab_size = 1 << 16;
+
+  public:
+    node_pool() = default;
+    node_pool(const node_pool&) = delete;
+    node_pool& operator=(const node_pool&) = delete;
+
+    node_pool(node_pool&& other) noexcept
+      : m_slabs(std::move(other.m_slabs)),
+        m_free_list(std::exchange(other.m_free_list, nullptr)),
+        m_slab_used(std::exchange(other.m_slab_used, 0)),
+        m_slab_size(std::exchange(other.m_slab_size, 0)),
+        m_capacity(std::exchange(other.m_capacity, 0)),
+        m_handed_out(std::exchange(other.m_handed_out, 0))
+    {
+    }
+
+    ~node_pool()
+    {
+      assert (!m_handed_out && "node handles must not outlive the pool their nodes come from");
+    }
+
+    template <typename... ArgTypes>
+    NodeType* create(ArgTypes&&... args)
+    {
+      if (m_free_list)
+      {
+        auto slot = m_free_list;
+        auto next_free = slot->next_free;
+        auto node = new (slot->storage) NodeType(std::forward<ArgTypes>(args)...);
+        m_free_list = next_free;
+        return node;
+      }
+
+      if (m_slab_used == m_slab_size)
+        add_slab();
+      auto node = new (m_slabs.back()[m_slab_used].storage) NodeType(std::forward<ArgTypes>(args)...);
+      ++m_slab_used;
+      return node;
+    }
+
+    void destroy(NodeType* node)
+    {
+      node->~NodeType();
+      push_free(reinterpret_cast<slot_t *>(node));
+    }
+
+    static constexpr bool releases_in_bulk = true;
+    // node storage belongs to the slab, only adopt() moves nodes between pools
+    static constexpr bool transferable_nodes = false;
+    // slabs stay while node handles own some of their slots, nodes of the tree have to be destroyed one by one then
+    void release()
+    {
+      if (m_handed_out)
+        return;
+      m_slabs.clear();
+      m_free_list = nullptr;
+      m_slab_used = m_slab_size = m_capacity = 0;
+    }
+
+    // takes ownership of nodes allocated by other pool, its spare slots go to the free list
+    void adopt(node_pool&& other)
+    {
+      if (!other.m_slabs.empty())
+      {
+        auto& last_slab = other.m_slabs.back();
+        for (auto i = other.m_slab_used; i < other.m_slab_size; ++i)
+          push_free(&last_slab[i]);
+      }
+      while (auto slot = other.m_free_list)
+      {
+        other.m_free_list = slot->next_free;
+        push_free(slot);
+      }
+      m_slabs.insert(m_slabs.begin(), std::make_move_iterator(other.m_slabs.begin()), std::make_move_iterator(other.m_slabs.end()));
+      other.m_slabs.clear();
+      m_capacity += std::exchange(other.m_capacity, 0);
+      m_handed_out += std::exchange(other.m_handed_out, 0);
+      other.m_slab_used = other.m_slab_size = 0;
+    }
+
+    // makes room for count more nodes with at most one allocation, spare slots of the last slab go to the free list
+    void reserve(std::size_t count)
+    {
+      if (m_slab_size - m_slab_used >= count)
+        return;
+      for (auto i = m_slab_used; i < m_slab_size; ++i)
+        push_free(&m_slabs.back()[i]);
+      m_slabs.emplace_back(new slot_t[count]);
+      m_slab_size = count;
+      m_slab_used = 0;
+      m_capacity += count;
+    }
+
+    void swap(node_pool& other) noexcept
+    {
+      std::swap(m_slabs, other.m_slabs);
+      std::swap(m_free_list, other.m_free_list);
+      std::swap(m_slab_used, other.m_slab_used);
+      std::swap(m_slab_size, other.m_slab_size);
+      std::swap(m_capacity, other.m_capacity);
+      std::swap(m_handed_out, other.m_handed_out);
+    }
+
+    std::size_t slab_count() const { return m_slabs.size(); }
+
+    // counts nodes owned by node handles
+    void hand_out() { ++m_handed_out; }
+    void take_back()
+    {
+      assert (m_handed_out);
+      --m_handed_out;
+    }
+    std::size_t handed_out() const { return m_handed_out; }
+    // bytes taken by slabs, whether their slots hold nodes or not
+    std::size_t slab_bytes() const { return m_capacity * sizeof(slot_t); }
+
+  private:
+    void push_free(slot_t* slot)
+    {
+      slot->next_free = m_free_list;
+      m_free_list = slot;
+    }
+
+    void add_slab()
+    {
+      m_slab_size = m_slab_size ? std::min(m_slab_size * 2, max_slab_size) : first_slab_size;
+      m_slabs.emplace_back(new slot_t[m_slab_size]);
+      m_slab_used = 0;
+      m_capacity += m_slab_size;
+    }
+
+  private:
+    std::vector<std::unique_ptr<slot_t[]>> m_slabs;
+    slot_t* m_free_list = nullptr;
+    std::size_t m_slab_used = 0;
+    std::size_t m_slab_size = 0;
+    std::size_t m_capacity = 0;
+    std::size_t m_handed_out = 0;
+  };
+
+  // plugin switching node allocation of the tree to node_pool
+  template <typename NodeType>
+  class pooled_allocation
   {
   public:
+    using node_allocator_t = node_pool<NodeType>;
+
     class node_t
     {
     public:
-      std::size_t node_count() const { return m_node_count; }
+      void recalculate() {}
+    };
 
-    private:
-      std::size_t m_node_count = 1;
+    template <typename TreeType>
+    class tree_t {};
+  };
 
-    public:
+  namespace detail
+  {
+    template <typename Plugin, typename = void>
+    struct node_allocator_of { using type = void; };
 
-      void on_new_child()
+    template <typename Plugin>
+    struct node_allocator_of<Plugin, std::void_t<typename Plugin::node_allocator_t>> { using type = typename Plugin::node_allocator_t; };
+
+    template <typename Default, typename... Allocators>
+    struct first_node_allocator { using type = Default; };
+
+    template <typename Default, typename... Allocators>
+    struct first_node_allocator<Default, void, Allocators...> : first_node_allocator<Default, Allocators...> {};
+
+    template <typename Default, typename Allocator, typename... Allocators>
+    struct first_node_allocator<Default, Allocator, Allocators...> { using type = Allocator; };
+
+    template <typename NodeType, typename = void>
+    struct has_node_count : std::false_type {};
+
+    template <typename NodeType>
+    struct has_node_count<NodeType, std::void_t<decltype(std::declval<const NodeType&>().node_count())>> : std::true_type {};
+
+    template <typename PluginTree, typename = void>
+    struct has_event_hook : std::false_type {};
+
+    template <typename PluginTree>
+    struct has_event_hook<PluginTree, std::void_t<decltype(std::declval<const PluginTree&>().on_event(tree_event{}, std::size_t{}))>> : std::true_type {};
+
+    constexpr std::size_t parallel_cutoff = 1 << 14;
+
+    inline unsigned default_thread_count()
+    {
+      return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    template <typename LhsFunc, typename RhsFunc>
+    void run_in_parallel(LhsFunc&& lhs_func, RhsFunc&& rhs_func)
+    {
+      std::thread lhs_thread(std::forward<LhsFunc>(lhs_func));
+      rhs_func();
+      lhs_thread.join();
+    }
+
+    // merges sorted [first1, last1) and [first2, last2) into out splitting the work by median of the longer range
+    template <typename RandomIt, typename OutputIt>
+    void parallel_merge(RandomIt first1, RandomIt last1, RandomIt first2, RandomIt last2, OutputIt out, unsigned thread_count)
+    {
+      if (last1 - first1 < last2 - first2)
       {
-        auto current = static_cast<NodeType *>(this)->parent();
-        while (current)
-        {
-          current->m_node_count += m_node_count;
-          current = current->parent();
-        }
+        std::swap(first1, first2);
+        std::swap(last1, last2);
       }
+      if (thread_count <= 1 || static_cast<std::size_t>((last1 - first1) + (last2 - first2)) < parallel_cutoff)
+      {
+        std::merge(std::make_move_iterator(first1), std::make_move_iterator(last1),
+                   std::make_move_iterator(first2), std::make_move_iterator(last2), out);
+        return;
+      }
+      auto middle1 = first1 + (last1 - first1) / 2;
+      auto middle2 = std::lower_bound(first2, last2, *middle1);
+      auto middle_out = out + ((middle1 - first1) + (middle2 - first2));
+      run_in_parallel([=] { parallel_merge(first1, middle1, first2, middle2, out, thread_count / 2); },
+                      [=] { parallel_merge(middle1, last1, middle2, last2, middle_out, thread_count - thread_count / 2); });
+    }
+
+    // sorts [first, last) using buffer of the same size as scratch space
+    template <typename RandomIt, typename BufferIt>
+    void parallel_sort(RandomIt first, RandomIt last, BufferIt buffer, unsigned thread_count)
+    {
+      auto count = last - first;
+      if (thread_count <= 1 || static_cast<std::size_t>(count) < parallel_cutoff)
+      {
+        std::sort(first, last);
+        return;
+      }
+      auto middle = first + count / 2;
+      auto buffer_middle = buffer + count / 2;
+      run_in_parallel([=] { parallel_sort(first, middle, buffer, thread_count / 2); },
+                      [=] { parallel_sort(middle, last, buffer_middle, thread_count - thread_count / 2); });
+      parallel_merge(first, middle, middle, last, buffer, thread_count);
+      run_in_parallel([=] { std::move(buffer, buffer_middle, first); },
+                      [=] { std::move(buffer_middle, buffer + count, middle); });
+    }
+
+    inline void prefetch([[maybe_unused]] const void* address)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+      __builtin_prefetch(address);
+#endif
+    }
+
+    inline int count_trailing_ones(std::size_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+      return ~value ? __builtin_ctzll(~static_cast<unsigned long long>(value)) : static_cast<int>(8 * sizeof(value));
+#else
+      int count = 0;
+      for (; value & 1; value >>= 1)
+        ++count;
+      return count;
+#endif
+    }
+
+    struct tree_file_header
+    {
+      char magic[8];
+      std::uint64_t count;
+      std::uint32_t key_size;
+      std::uint32_t reserved;
+    };
+
+    constexpr char tree_file_magic[8] = {'b', 't', 'r', 'e', 'e', 'k', 'e', 'y'};
+
+    // keys follow the header at their natural alignment
+    template <typename KeyType>
+    constexpr std::size_t tree_file_keys_offset = (sizeof(tree_file_header) + alignof(KeyType) - 1) / alignof(KeyType) * alignof(KeyType);
+
+    // key count stored in the header, nothing if it doesn't belong to a file of KeyType keys
+    template <typename KeyType>
+    std::optional<std::size_t> read_tree_file_header(const void* data)
+    {
+      tree_file_header header;
+      std::memcpy(&header, data, sizeof(header));
+      if (std::memcmp(header.magic, tree_file_magic, sizeof(header.magic)) != 0 || header.key_size != sizeof(KeyType))
+        return std::nullopt;
+      return static_cast<std::size_t>(header.count);
+    }
+  } // namespace detail
+
+  // immutable search index over sorted keys stored contiguously in Eytzinger (BFS) order,
+  // children of 1-based slot k are 2k and 2k + 1; lookups go down without branching on keys
+  // and prefetch the cache line holding the descendants several levels below
+  template <typename KeyType>
+  class eytzinger_index
+  {
+  public:
+    eytzinger_index() = default;
+
+    // [first, last) has to be sorted
+    template <typename ForwardIt>
+    eytzinger_index(ForwardIt first, ForwardIt last)
+    {
+      std::vector<KeyType> sorted(first, last);
+      m_ranks.resize(sorted.size());
+      std::size_t rank = 0;
+      assign_ranks(1, rank);
+      m_keys.reserve(sorted.size());
+      for (auto slot_rank : m_ranks)
+        m_keys.push_back(std::move(sorted[slot_rank]));
+    }
+
+    std::size_t size() const { return m_keys.size(); }
+    bool empty() const { return m_keys.empty(); }
+
+    // number of keys less than key, which is the index() of the first such key in the tree
+    template <typename ArgType>
+    std::size_t lower_bound(const ArgType& key) const
+    {
+      return rank_of(descend([&](const KeyType& slot_key) { return slot_key < key; }));
+    }
+
+    // number of keys not greater than key
+    template <typename ArgType>
+    std::size_t upper_bound(const ArgType& key) const
+    {
+      return rank_of(descend([&](const KeyType& slot_key) { return !(key < slot_key); }));
+    }
 
-      void before_takeout()
+    template <typename ArgType>
+    bool contains(const ArgType& key) const
+    {
+      auto slot = descend([&](const KeyType& slot_key) { return slot_key < key; });
+      return slot && !(key < m_keys[slot - 1]);
+    }
+
+  private:
+    // descendants of slot k several levels down start at slot k * stride and share one cache line
+    static constexpr std::size_t prefetch_stride = std::max<std::size_t>(64 / sizeof(KeyType), 1);
+
+    void assign_ranks(std::size_t slot, std::size_t& rank)
+    {
+      if (slot > m_ranks.size())
+        return;
+      assign_ranks(2 * slot, rank);
+      m_ranks[slot - 1] = rank++;
+      assign_ranks(2 * slot + 1, rank);
+    }
+
+    // slot of the first key for which goes_right is false, 0 if there is none
+    template <typename GoesRight>
+    std::size_t descend(GoesRight goes_right) const
+    {
+      auto keys = m_keys.data();
+      auto count = m_keys.size();
+      std::size_t slot = 1;
+      while (slot <= count)
       {
-        auto current = static_cast<NodeType *>(this)->parent();
-        while (current)
-        {
-          current->m_node_count -= m_node_count;
-          current = current->parent();
-        }
+        detail::prefetch(keys + std::min(slot * prefetch_stride, count) - 1);
+        slot = 2 * slot + static_cast<std::size_t>(goes_right(keys[slot - 1]));
+      }
+      // every right turn after the last left turn is undone together with that left turn
+      return slot >> (detail::count_trailing_ones(slot) + 1);
+    }
+
+    std::size_t rank_of(std::size_t slot) const
+    {
+      return slot ? m_ranks[slot - 1] : m_keys.size();
+    }
+
+  private:
+    std::vector<KeyType> m_keys;
+    // rank of the key in every slot
+    std::vector<std::size_t> m_ranks;
+  };
+
+  template <typename NodeType>
+  class indexation_plugin
+  {
+  public:
+    class node_t
+    {
+    public:
+      std::size_t node_count() const { return m_node_count; }
+
+      void recalculate()
+      {
+        auto node = static_cast<NodeType *>(this);
+        m_node_count = 1;
+        for (auto direction : {left, right})
+          if (auto child = node->child(direction))
+            m_node_count += child->node_count();
       }
+
+    private:
+      std::size_t m_node_count = 1;
     };
 
     template <typename TreeType>
@@ -94,520 +514,1955 @@ namespace btree
 
         return static_cast<std::size_t>(-1);
       }
+
+      // iterator to k-th smallest key, end() if k >= size()
+      auto select(std::size_t k)
+      {
+        auto tree = static_cast<TreeType*>(this);
+        auto current = tree->root();
+        while (current)
+        {
+          auto left_count = left_node_count(current);
+          if (k < left_count)
+            current = current->child(left);
+          else if (k > left_count)
+          {
+            k -= left_count + 1;
+            current = current->child(right);
+          }
+          else
+            return typename TreeType::iterator(current);
+        }
+        return tree->end();
+      }
+
+      // number of keys less than key
+      template <typename ArgType>
+      std::size_t count_less(const ArgType& key) const
+      {
+        auto current = static_cast<const TreeType*>(this)->root();
+        std::size_t count = 0;
+        while (current)
+        {
+          if (current->key() < key)
+          {
+            count += left_node_count(current) + 1;
+            current = current->child(right);
+          }
+          else
+            current = current->child(left);
+        }
+        return count;
+      }
+
+      // number of keys in [lo, hi)
+      template <typename LoType, typename HiType>
+      std::size_t count_range(const LoType& lo, const HiType& hi) const
+      {
+        auto lo_count = count_less(lo);
+        auto hi_count = count_less(hi);
+        return hi_count > lo_count ? hi_count - lo_count : 0;
+      }
+
+    private:
+      static std::size_t left_node_count(const NodeType* node)
+      {
+        return node->child(left) ? node->child(left)->node_count() : 0;
+      }
     };
   };
 
-  template <typename KeyType, typename NodeType, template <typename> class... Plugins>
-  struct btree_container
+  struct identity_projection
   {
-    class tree_t;
-    class node_t;
-    class iterator_t;
-    class base_node_t;
-    using node_storage_t = std::unique_ptr<base_node_t, void (*)(base_node_t *)>;
-    static void delete_node(base_node_t *node) { delete static_cast<NodeType *> (node); }
-    template <typename ArgType>
-    static node_storage_t make_node (ArgType &&key) { return node_storage_t (new NodeType (std::forward<ArgType> (key)), &delete_node); }
+    template <typename T>
+    const T& operator()(const T& value) const { return value; }
+  };
 
-  public:
-    class base_node_t
-    {
-    protected:
-      base_node_t (bool is_sentinel_arg) : is_sentinel (is_sentinel_arg) {}
-      bool is_sentinel : 1;
-      friend class node_t;
-      friend class iterator_t;
-    };
+  struct min_combine
+  {
+    template <typename T>
+    const T& operator()(const T& lhs, const T& rhs) const { return rhs < lhs ? rhs : lhs; }
+  };
 
-    class sentinel_t : public base_node_t
-    {
-    public:
-      sentinel_t(tree_t* tree_ptr) : base_node_t (true), m_tree_ptr(tree_ptr) {}
-    private:
-      tree_t* m_tree_ptr;
-      friend class iterator_t;
-    };
+  struct max_combine
+  {
+    template <typename T>
+    const T& operator()(const T& lhs, const T& rhs) const { return lhs < rhs ? rhs : lhs; }
+  };
 
-    class node_t : public base_node_t, public Plugins<NodeType>::node_t...
+  // every node caches Combine over Projection of all keys in its subtree (in key order),
+  // Combine has to be associative but not necessarily commutative, usage:
+  // rb_tree_container<int, aggregation_plugin<long long, identity_projection, std::plus<>>::type>
+  // aggregate() names would clash for two such plugins in one tree, use a compound ValueType instead
+  template <typename ValueType, typename Projection, typename Combine>
+  struct aggregation_plugin
+  {
+    template <typename NodeType>
+    class type
     {
     public:
-      template <typename ArgType>
-      explicit node_t(ArgType&& key) : base_node_t (false),
-        m_children {node_storage_t {nullptr, &delete_node}, node_storage_t {nullptr, &delete_node}},
-        m_key(std::forward<ArgType>(key))
+      class node_t
       {
-      }
-      ~node_t (){}
+      public:
+        const ValueType& subtree_aggregate() const { return m_aggregate; }
 
-      const auto& key() const { return m_key; }
+        void recalculate()
+        {
+          auto node = static_cast<NodeType *>(this);
+          m_aggregate = Projection{}(node->key());
+          if (auto child = node->child(left))
+            m_aggregate = Combine{}(child->subtree_aggregate(), m_aggregate);
+          if (auto child = node->child(right))
+            m_aggregate = Combine{}(m_aggregate, child->subtree_aggregate());
+        }
 
-      const NodeType* child(direction_t direction) const
-      {
-        return m_children[direction] && !m_children[direction]->is_sentinel ? static_cast<const NodeType*>(m_children[direction].get()) : nullptr;
-      }
+      private:
+        ValueType m_aggregate {};
+      };
 
-      NodeType* child(direction_t direction)
+      template <typename TreeType>
+      class tree_t
       {
-        return m_children[direction] && !m_children[direction]->is_sentinel ? static_cast<NodeType*>(m_children[direction].get()) : nullptr;
-      }
+      public:
+        // aggregate of the whole tree, nullopt if it's empty
+        std::optional<ValueType> aggregate() const
+        {
+          auto root = static_cast<const TreeType*>(this)->root();
+          if (!root)
+            return std::nullopt;
+          return root->subtree_aggregate();
+        }
 
-      const NodeType* parent() const { return m_parent; }
-      NodeType* parent() { return m_parent; }
+        // aggregate of keys in [lo, hi), nullopt if there's none
+        template <typename LoType, typename HiType>
+        std::optional<ValueType> aggregate(const LoType& lo, const HiType& hi) const
+        {
+          auto current = static_cast<const TreeType*>(this)->root();
+          while (current)
+          {
+            if (current->key() < lo)
+              current = current->child(right);
+            else if (!(current->key() < hi))
+              current = current->child(left);
+            else
+              break;
+          }
+          if (!current)
+            return std::nullopt;
+
+          // current is the topmost node in range, left subtree contributes suffix and right one prefix
+          auto result = suffix(current->child(left), lo);
+          append(result, Projection{}(current->key()));
+          if (auto prefix_value = prefix(current->child(right), hi))
+            append(result, *prefix_value);
+          return result;
+        }
 
-      NodeType* furthest_node(direction_t direction)
-      {
-        auto cur_node = this;
-        while (auto next_node = cur_node->child(direction))
-          cur_node = next_node;
-        return static_cast<NodeType *>(cur_node);
-      }
+      private:
+        static void append(std::optional<ValueType>& acc, const ValueType& value)
+        {
+          acc = acc ? Combine{}(*acc, value) : value;
+        }
 
-      NodeType* next_node(direction_t direction)
-      {
-        if (auto c = child(direction))
+        static void prepend(std::optional<ValueType>& acc, const ValueType& value)
         {
-          return c->furthest_node(other_direction(direction));
+          acc = acc ? Combine{}(value, *acc) : value;
         }
 
-        auto cur_node = this;
-        while (cur_node->parent() && cur_node->direction_from_parent() == direction)
-          cur_node = cur_node->parent();
-        return cur_node->parent();
-      }
+        // aggregate of keys not less than lo
+        template <typename LoType>
+        static std::optional<ValueType> suffix(const NodeType* current, const LoType& lo)
+        {
+          std::optional<ValueType> result;
+          while (current)
+          {
+            if (current->key() < lo)
+              current = current->child(right);
+            else
+            {
+              if (auto child = current->child(right))
+                prepend(result, child->subtree_aggregate());
+              prepend(result, Projection{}(current->key()));
+              current = current->child(left);
+            }
+          }
+          return result;
+        }
 
-      NodeType* uncle()
-      {
-        assert (m_parent);
-        return m_parent->sibling();
-      }
+        // aggregate of keys less than hi
+        template <typename HiType>
+        static std::optional<ValueType> prefix(const NodeType* current, const HiType& hi)
+        {
+          std::optional<ValueType> result;
+          while (current)
+          {
+            if (current->key() < hi)
+            {
+              if (auto child = current->child(left))
+                append(result, child->subtree_aggregate());
+              append(result, Projection{}(current->key()));
+              current = current->child(right);
+            }
+            else
+              current = current->child(left);
+          }
+          return result;
+        }
+      };
+    };
+  };
 
-      NodeType* sibling()
-      {
-        return m_parent ? m_parent->child(other_direction(direction_from_parent())) : nullptr;
-      }
+  struct first_projection
+  {
+    template <typename T>
+    const auto& operator()(const T& value) const { return value.first; }
+  };
 
-      int child_count() const
-      {
-        int cnt = 0;
-        for (auto direction : {left, right})
-          cnt += (child(direction) != nullptr);
-        return cnt;
-      }
+  struct second_projection
+  {
+    template <typename T>
+    const auto& operator()(const T& value) const { return value.second; }
+  };
 
-      NodeType* single_child()
+  // keys are closed intervals [Low(key), High(key)] ordered by their low endpoints first,
+  // every node caches the greatest high endpoint in its subtree, usage:
+  // rb_tree_container<std::pair<int, int>, interval_plugin<int>::type>
+  template <typename EndpointType, typename Low = first_projection, typename High = second_projection>
+  struct interval_plugin
+  {
+    template <typename NodeType>
+    class type
+    {
+    public:
+      class node_t
       {
-        assert (child_count() <= 1);
-        for (auto child_direction : {left, right})
+      public:
+        const EndpointType& subtree_max_high() const { return m_max_high; }
+
+        void recalculate()
         {
-          if (auto c = child(child_direction))
-            return c;
+          auto node = static_cast<NodeType *>(this);
+          m_max_high = High{}(node->key());
+          for (auto direction : {left, right})
+            if (auto child = node->child(direction))
+              m_max_high = max_combine{}(m_max_high, child->subtree_max_high());
         }
-        return nullptr;
-      }
 
-      bool is_root()
-      {
-        return m_parent == nullptr;
-      }
+      private:
+        EndpointType m_max_high {};
+      };
 
-      direction_t direction_from_parent() const
+      template <typename TreeType>
+      class tree_t
       {
-        if (!m_parent)
+      public:
+        // intervals intersecting [lo, hi] in key order, in O(min(n, (k + 1) log n)) for k intervals found
+        auto overlapping(const EndpointType& lo, const EndpointType& hi)
+        {
+          std::vector<typename TreeType::iterator> result;
+          if (!(hi < lo))
+            collect(static_cast<TreeType*>(this)->root(), lo, hi, result);
+          return result;
+        }
+
+        // intervals containing point
+        auto stabbing(const EndpointType& point)
+        {
+          return overlapping(point, point);
+        }
+
+      private:
+        // subtrees ending before lo are skipped, and so are right subtrees of nodes starting after hi
+        template <typename IteratorList>
+        static void collect(NodeType* node, const EndpointType& lo, const EndpointType& hi, IteratorList& result)
+        {
+          while (node && !(node->subtree_max_high() < lo))
+          {
+            collect(node->child(left), lo, hi, result);
+            if (hi < Low{}(node->key()))
+              return;
+            if (!(High{}(node->key()) < lo))
+              result.emplace_back(node);
+            node = node->child(right);
+          }
+        }
+      };
+    };
+  };
+
+  struct tree_stats
+  {
+    std::size_t comparisons = 0;
+    std::size_t rotations = 0;
+    std::size_t recolorings = 0;
+    std::size_t allocations = 0;
+    std::size_t deallocations = 0;
+    std::size_t insertions = 0;
+    std::size_t erasures = 0;
+    std::size_t lookups = 0;
+    std::size_t max_depth = 0;
+    // number of insertions by depth of the inserted node
+    std::vector<std::size_t> depth_histogram;
+  };
+
+  // counts tree events, per operation figures are the counters divided by insertions, erasures or lookups;
+  // trees without this plugin don't pay anything for it
+  template <typename NodeType>
+  class stats_plugin
+  {
+  public:
+    class node_t
+    {
+    public:
+      void recalculate() {}
+    };
+
+    template <typename TreeType>
+    class tree_t
+    {
+    public:
+      const tree_stats& stats() const { return m_stats; }
+      void reset_stats() { m_stats = {}; }
+
+      void on_event(tree_event event, std::size_t value) const
+      {
+        switch (event)
+        {
+        case tree_event::comparison: m_stats.comparisons += value; break;
+        case tree_event::rotation: m_stats.rotations += value; break;
+        case tree_event::recoloring: m_stats.recolorings += value; break;
+        case tree_event::allocation: m_stats.allocations += value; break;
+        case tree_event::deallocation: m_stats.deallocations += value; break;
+        case tree_event::erasure: m_stats.erasures += value; break;
+        case tree_event::lookup: m_stats.lookups += value; break;
+        case tree_event::insertion:
+          ++m_stats.insertions;
+          m_stats.max_depth = std::max(m_stats.max_depth, value);
+          if (m_stats.depth_histogram.size() <= value)
+            m_stats.depth_histogram.resize(value + 1);
+          ++m_stats.depth_histogram[value];
+          break;
+        }
+      }
+
+    private:
+      mutable tree_stats m_stats;
+    };
+  };
+
+  template <typename KeyType, typename NodeType, template <typename> class... Plugins>
+  struct btree_container
+  {
+    class tree_t;
+    class node_t;
+    class iterator_t;
+    class node_handle_t;
+    class base_node_t;
+    using node_allocator_t = typename detail::first_node_allocator<heap_node_allocator<NodeType>,
+      typename detail::node_allocator_of<Plugins<NodeType>>::type...>::type;
+
+  public:
+    // links never point to the sentinel directly, the only link to it (right child of the rightmost node)
+    // is tagged with the lowest bit, so nodes don't need to carry any flag
+    class base_node_t
+    {
+    };
+
+    // the sentinel keeps the furthest nodes so that decrementing end() doesn't need the tree,
+    // nothing in it points back to the tree which makes moving the tree O(1)
+    class sentinel_t : public base_node_t
+    {
+      std::array<NodeType *, 2> m_furthest_node = {nullptr, nullptr};
+      friend class iterator_t;
+      friend class tree_t;
+    };
+
+    static constexpr std::uintptr_t sentinel_tag = 1;
+
+    static bool is_sentinel(const base_node_t* link)
+    {
+      return (reinterpret_cast<std::uintptr_t>(link) & sentinel_tag) != 0;
+    }
+
+    static base_node_t* sentinel_link(sentinel_t* sentinel)
+    {
+      return reinterpret_cast<base_node_t *>(reinterpret_cast<std::uintptr_t>(static_cast<base_node_t *>(sentinel)) | sentinel_tag);
+    }
+
+    static sentinel_t* sentinel_from_link(base_node_t* link)
+    {
+      assert (is_sentinel(link));
+      return static_cast<sentinel_t *>(reinterpret_cast<base_node_t *>(reinterpret_cast<std::uintptr_t>(link) & ~sentinel_tag));
+    }
+
+    class node_t : public base_node_t, public Plugins<NodeType>::node_t...
+    {
+    public:
+      template <typename... ArgTypes>
+      explicit node_t(ArgTypes&&... args) : m_key(std::forward<ArgTypes>(args)...)
+      {
+      }
+
+      const auto& key() const { return m_key; }
+
+      const NodeType* child(direction_t direction) const
+      {
+        return m_children[direction] && !is_sentinel(m_children[direction]) ? static_cast<const NodeType*>(m_children[direction]) : nullptr;
+      }
+
+      NodeType* child(direction_t direction)
+      {
+        return m_children[direction] && !is_sentinel(m_children[direction]) ? static_cast<NodeType*>(m_children[direction]) : nullptr;
+      }
+
+      const NodeType* parent() const { return reinterpret_cast<const NodeType *>(m_parent_bits & ~parent_tag_mask); }
+      NodeType* parent() { return reinterpret_cast<NodeType *>(m_parent_bits & ~parent_tag_mask); }
+
+      NodeType* furthest_node(direction_t direction)
+      {
+        auto cur_node = this;
+        while (auto next_node = cur_node->child(direction))
+          cur_node = next_node;
+        return static_cast<NodeType *>(cur_node);
+      }
+
+      NodeType* next_node(direction_t direction)
+      {
+        if (auto c = child(direction))
+        {
+          return c->furthest_node(other_direction(direction));
+        }
+
+        auto cur_node = this;
+        while (cur_node->parent() && cur_node->direction_from_parent() == direction)
+          cur_node = cur_node->parent();
+        return cur_node->parent();
+      }
+
+      NodeType* uncle()
+      {
+        assert (parent());
+        return parent()->sibling();
+      }
+
+      NodeType* sibling()
+      {
+        return parent() ? parent()->child(other_direction(direction_from_parent())) : nullptr;
+      }
+
+      int child_count() const
+      {
+        int cnt = 0;
+        for (auto direction : {left, right})
+          cnt += (child(direction) != nullptr);
+        return cnt;
+      }
+
+      NodeType* single_child()
+      {
+        assert (child_count() <= 1);
+        for (auto child_direction : {left, right})
+        {
+          if (auto c = child(child_direction))
+            return c;
+        }
+        return nullptr;
+      }
+
+      bool is_root()
+      {
+        return parent() == nullptr;
+      }
+
+      direction_t direction_from_parent() const
+      {
+        if (!parent())
           return none;
         for (auto b : {left, right})
-          if (m_parent->m_children[b].get() == this)
+          if (parent()->m_children[b] == this)
             return b;
         assert (false);
         return left;
       }
 
-      node_storage_t take_out()
+      // detaches node from its parent, ownership goes to the caller
+      NodeType* take_out()
       {
-        if (this->is_sentinel)
-          return {nullptr, &delete_node};
-        std::initializer_list<int>{(static_cast<typename Plugins<NodeType>::node_t*>(this)->before_takeout() , 0)...};
-        auto parent = this->m_parent;
         auto direction = direction_from_parent();
-        this->m_parent = nullptr;
-        auto raw_ptr = parent->m_children[direction].release ();
-        return node_storage_t (static_cast<NodeType *>(raw_ptr), &delete_node);
+        parent()->m_children[direction] = nullptr;
+        set_parent(nullptr);
+        return static_cast<NodeType *>(this);
+      }
+
+      NodeType* append_child(direction_t dir, base_node_t* node)
+      {
+        assert (m_children[dir] == nullptr || is_sentinel(m_children[dir]));
+        m_children[dir] = node;
+        if (!is_sentinel(m_children[dir]))
+          static_cast<NodeType *>(m_children[dir])->set_parent(static_cast<NodeType *>(this));
+
+        return this->child(dir);
+      }
+
+      // plugin data of a node is computed from its key and children only,
+      // so linking functions don't touch it and the tree recalculates changed nodes bottom-up
+      void recalculate()
+      {
+        std::initializer_list<int>{(static_cast<typename Plugins<NodeType>::node_t*>(this)->recalculate() , 0)...};
+      }
+
+      void recalculate_upwards()
+      {
+        if (sizeof...(Plugins) == 0)
+          return;
+        for (auto current = static_cast<NodeType *>(this); current; current = current->parent())
+          current->recalculate();
+      }
+
+    protected:
+      // two lowest bits of parent pointer are free for the balancing policy
+      static constexpr std::uintptr_t parent_tag_mask = 3;
+      unsigned parent_tag() const { return static_cast<unsigned>(m_parent_bits & parent_tag_mask); }
+      void set_parent_tag(unsigned value) { m_parent_bits = (m_parent_bits & ~parent_tag_mask) | value; }
+
+    private:
+      void set_parent(NodeType* parent)
+      {
+        m_parent_bits = reinterpret_cast<std::uintptr_t>(parent) | (m_parent_bits & parent_tag_mask);
+      }
+
+    private:
+      std::array<base_node_t*, 2> m_children = {nullptr, nullptr};
+      std::uintptr_t m_parent_bits = 0;
+      KeyType m_key;
+
+      friend class tree_t;
+      friend class iterator_t;
+      friend class node_handle_t;
+    };
+
+    class iterator_t
+    {
+      using node_type = NodeType;
+      using self = iterator_t;
+    public:
+      using iterator_category = std::bidirectional_iterator_tag;
+      using reference = const KeyType &;
+      using pointer = const KeyType *;
+      using value_type = const KeyType;
+      using difference_type = std::size_t;
+    public:
+      iterator_t(base_node_t* node) : m_node_ptr(node)
+      {
+      }
+
+      self& operator++()
+      {
+        auto next_node = get_node()->next_node(right);
+        if (next_node == nullptr)
+        {
+          m_node_ptr = get_node()->m_children[right];
+          assert (is_sentinel(m_node_ptr));
+        }
+        else
+          m_node_ptr = next_node;
+        return *this;
+      }
+
+      self& operator--()
+      {
+        if (!is_sentinel(m_node_ptr))
+          m_node_ptr = get_node()->next_node(left);
+        else
+          m_node_ptr = sentinel_from_link(m_node_ptr)->m_furthest_node[right];
+
+        return *this;
+      }
+
+      reference operator*()
+      {
+        return get_node()->key();
+      }
+
+      bool operator==(const self& other)
+      {
+        return m_node_ptr == other.m_node_ptr;
+      }
+
+      bool operator!=(const self& other)
+      {
+        return !(*this == other);
+      }
+
+    private:
+      node_t* get_node() const
+      {
+        assert (!is_sentinel(m_node_ptr));
+        return static_cast<node_t *>(m_node_ptr);
+      }
+
+    private:
+      base_node_t* m_node_ptr;
+
+      friend class tree_t;
+    };
+
+    // owns a node taken out of a tree, its key may be changed before the node is linked back,
+    // pooled nodes can only return to the tree they came from, which must neither be destroyed nor moved meanwhile;
+    // clear() of that tree is fine, its pool keeps the slabs while handles are outstanding
+    class node_handle_t
+    {
+    public:
+      node_handle_t() = default;
+      node_handle_t(const node_handle_t&) = delete;
+      node_handle_t& operator=(const node_handle_t&) = delete;
+
+      node_handle_t(node_handle_t&& other) noexcept
+        : m_node(std::exchange(other.m_node, nullptr)), m_allocator(other.m_allocator)
+      {
       }
 
-      NodeType* append_child(direction_t dir, node_storage_t node)
+      node_handle_t& operator=(node_handle_t&& other) noexcept
       {
-        assert (m_children[dir] == nullptr || m_children[dir]->is_sentinel);
-        m_children[dir] = std::move(node);
-        if (!m_children[dir]->is_sentinel)
+        if (this != &other)
         {
-          static_cast<NodeType *>(m_children[dir].get())->m_parent = static_cast<NodeType *>(this);
-          std::initializer_list<int>{(static_cast<typename Plugins<NodeType>::node_t*>(this->child(dir))->on_new_child() , 0)...};
+          reset();
+          m_node = std::exchange(other.m_node, nullptr);
+          m_allocator = other.m_allocator;
         }
+        return *this;
+      }
+
+      ~node_handle_t() { reset(); }
+
+      bool empty() const { return !m_node; }
+      explicit operator bool() const { return m_node != nullptr; }
+
+      KeyType& key()
+      {
+        assert (m_node);
+        return m_node->m_key;
+      }
+
+    private:
+      node_handle_t(NodeType* node, node_allocator_t* allocator) : m_node(node), m_allocator(allocator) {}
+
+      void reset()
+      {
+        if (!m_node)
+          return;
+        m_allocator->destroy(std::exchange(m_node, nullptr));
+        m_allocator->take_back();
+      }
+
+      NodeType* m_node = nullptr;
+      node_allocator_t* m_allocator = nullptr;
+
+      friend class tree_t;
+    };
+
+    class tree_t : public Plugins<NodeType>::template tree_t<tree_t>...
+    {
+      using self = tree_t;
+      static_assert (alignof (NodeType) > node_t::parent_tag_mask, "parent pointer has to leave tag bits free");
+    public:
+      using iterator = iterator_t;
+      using node_handle = node_handle_t;
+
+      tree_t () : m_size (0)
+      {
+
+      }
+
+      // copies the shape with balancing tags and plugin data of every node in one pass,
+      // without comparisons or rebalancing; pooled trees get memory for all nodes at once
+      tree_t (const tree_t &other) : tree_t ()
+      {
+        copy_from (other);
+      }
+
+      tree_t &operator= (const tree_t &other)
+      {
+        if (this != &other)
+          {
+            clear ();
+            copy_from (other);
+          }
+        return *this;
+      }
+
+      // iterators to keys stay valid and belong to the new tree, end() of the moved from tree doesn't
+      tree_t (tree_t &&other) noexcept : tree_t ()
+      {
+        swap (other);
+      }
+
+      tree_t &operator= (tree_t &&other) noexcept
+      {
+        if (this != &other)
+          {
+            clear ();
+            swap (other);
+          }
+        return *this;
+      }
+
+      void swap (tree_t &other) noexcept
+      {
+        std::swap (m_sentinel.m_furthest_node, other.m_sentinel.m_furthest_node);
+        std::swap (m_size, other.m_size);
+        std::swap (m_root, other.m_root);
+        m_allocator.swap (other.m_allocator);
+        (std::swap (static_cast<typename Plugins<NodeType>::template tree_t<tree_t> &> (*this),
+                    static_cast<typename Plugins<NodeType>::template tree_t<tree_t> &> (other)), ...);
+        relink_sentinel ();
+        other.relink_sentinel ();
+      }
+
+      friend void swap (tree_t &lhs, tree_t &rhs) noexcept { lhs.swap (rhs); }
+
+      ~tree_t () { clear (); }
+
+      iterator_t begin()
+      {
+        if (!m_root)
+          return end();
+        return {furthest_node(left)};
+      }
+
+      iterator_t end()
+      {
+        return {make_sentinel()};
+      }
+
+      // lookups accept any type comparable with KeyType through operator< in both directions
+      template <typename ArgType>
+      iterator_t lower_bound(const ArgType& key)
+      {
+        return to_iterator(first_node_where([&](const KeyType& node_key) { return !key_less(node_key, key); }));
+      }
+
+      template <typename ArgType>
+      iterator_t upper_bound(const ArgType& key)
+      {
+        return to_iterator(first_node_where([&](const KeyType& node_key) { return key_less(key, node_key); }));
+      }
+
+      template <typename ArgType>
+      std::pair<iterator_t, iterator_t> equal_range(const ArgType& key)
+      {
+        return {lower_bound(key), upper_bound(key)};
+      }
+
+      template <typename ArgType>
+      iterator_t find(const ArgType& key)
+      {
+        return to_iterator(find_node(key));
+      }
+
+      template <typename ArgType>
+      bool contains(const ArgType& key) const
+      {
+        return find_node(key) != nullptr;
+      }
+
+      // read-only copy of the keys for fast searches, ranks it returns match index()
+      eytzinger_index<KeyType> freeze()
+      {
+        return {begin(), end()};
+      }
+
+      // header and in-order keys in native byte order, the tree shape isn't stored
+      // because rb trees load it back as a perfectly balanced tree in O(n)
+      void write(std::ostream& stream)
+      {
+        static_assert(std::is_trivially_copyable<KeyType>::value, "keys are written as raw bytes");
+        detail::tree_file_header header {};
+        std::memcpy(header.magic, detail::tree_file_magic, sizeof(header.magic));
+        header.count = size();
+        header.key_size = sizeof(KeyType);
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        const char padding[alignof(KeyType)] = {};
+        stream.write(padding, detail::tree_file_keys_offset<KeyType> - sizeof(header));
+
+        std::vector<KeyType> chunk;
+        chunk.reserve(std::max<std::size_t>(1, (std::size_t(1) << 16) / sizeof(KeyType)));
+        auto flush = [&]
+        {
+          stream.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(chunk.size() * sizeof(KeyType)));
+          chunk.clear();
+        };
+        for (auto it = begin(); it != end(); ++it)
+        {
+          chunk.push_back(*it);
+          if (chunk.size() == chunk.capacity())
+            flush();
+        }
+        flush();
+      }
+
+
+      void clear()
+      {
+        if (!node_allocator_t::releases_in_bulk || !std::is_trivially_destructible<NodeType>::value || m_allocator.handed_out())
+          destroy_subtree (m_root);
+        else if constexpr (has_event_listeners)
+          notify (tree_event::deallocation, count_nodes (m_root));
+        m_allocator.release ();
+        m_root = nullptr;
+        m_sentinel.m_furthest_node.fill (nullptr);
+        m_size = 0;
+      }
+
+      NodeType* take_out(NodeType* node)
+      {
+        if (node->parent())
+          return node->take_out();
+
+        m_root = nullptr;
+        return node;
+      }
+
+      void replace_with_child(NodeType* node)
+      {
+        auto cnt = node->child_count();
+        auto direction = node->direction_from_parent();
+        auto parent = node->parent();
+        take_out(node);
+        auto update_furthest_nodes =
+        [&]()
+        {
+          for (auto furthest_node_dir : {left, right})
+            if (node == m_sentinel.m_furthest_node[furthest_node_dir])
+              {
+                // the child which took the place of node may have a subtree of its own
+                auto heir = parent ? parent->child (furthest_node_dir) : m_root;
+                m_sentinel.m_furthest_node[furthest_node_dir] = heir ? heir->furthest_node (furthest_node_dir) : parent;
+                if (furthest_node_dir == right && m_sentinel.m_furthest_node[right])
+                  m_sentinel.m_furthest_node[right]->append_child (right, make_sentinel());
+              }
+        };
+
+        if (cnt != 0)
+        {
+          if (parent)
+            parent->append_child(direction, take_out(node->single_child()));
+          else
+            m_root = node->single_child()->take_out();
+        }
+        if (parent)
+          parent->recalculate_upwards();
+        update_furthest_nodes ();
+        node->m_children = {nullptr, nullptr};
+      }
+
+      void rotate(NodeType* node, direction_t dir)
+      {
+        auto prev_parent = node->parent();
+        direction_t prev_direction = none;
+        if (prev_parent)
+          prev_direction = node->direction_from_parent();
+        auto hanging_node = take_out(node);
+        auto heritor = take_out(node->child(other_direction(dir)));
+        if (heritor->child(dir))
+          node->append_child(other_direction(dir), take_out(heritor->child(dir)));
+
+        heritor->append_child(dir, hanging_node);
+        if (prev_parent)
+          prev_parent->append_child(prev_direction, heritor);
+        else
+          m_root = heritor;
+
+        // subtree as a whole stays the same, so ancestors are unaffected
+        node->recalculate();
+        heritor->recalculate();
+        notify(tree_event::rotation);
+      }
+
+      template <typename ArgType>
+      std::size_t erase(const ArgType& key)
+      {
+        auto current = preerase(key);
+        if (!current)
+          return 0;
+
+        replace_with_child(current);
+        destroy_node(current);
+        return 1;
+      }
+
+      // O(1) except after split of a tree without node_count(), which leaves sizes of both parts unknown,
+      // then every call counts the nodes in O(n) until recount() stores the result
+      std::size_t size() const
+      {
+        return m_size == unknown_size ? count_nodes(m_root) : m_size;
+      }
+
+      // makes size() O(1) again after split, in O(n) if the size is unknown
+      std::size_t recount()
+      {
+        if (m_size == unknown_size)
+          m_size = count_nodes(m_root);
+        return m_size;
+      }
+      const node_allocator_t& node_allocator() const { return m_allocator; }
+
+      const NodeType* root() const { return m_root; }
+      NodeType* root() { return m_root; }
+
+    protected:
+      static constexpr std::size_t unknown_size = static_cast<std::size_t>(-1);
+
+      NodeType* furthest_node(direction_t direction)
+      {
+        return m_sentinel.m_furthest_node[direction];
+      }
+
+      void destroy_node(NodeType* node)
+      {
+        m_allocator.destroy(node);
+        notify(tree_event::deallocation);
+      }
+
+      static constexpr bool has_event_listeners =
+        (detail::has_event_hook<typename Plugins<NodeType>::template tree_t<tree_t>>::value || ...);
+
+      // compiles to nothing unless some plugin listens to events
+      void notify([[maybe_unused]] tree_event event, [[maybe_unused]] std::size_t value = 1) const
+      {
+        if constexpr (has_event_listeners)
+          (notify_plugin<typename Plugins<NodeType>::template tree_t<tree_t>>(event, value), ...);
+      }
+
+      // key comparisons of the tree go through here so that they can be counted
+      template <typename LhsType, typename RhsType>
+      bool key_less(const LhsType& lhs, const RhsType& rhs) const
+      {
+        notify(tree_event::comparison);
+        return lhs < rhs;
+      }
+
+      // leaves the tree empty without destroying nodes, returns detached former root
+      NodeType* release_nodes()
+      {
+        if (m_root)
+          m_sentinel.m_furthest_node[right]->m_children[right] = nullptr;
+        auto root = m_root;
+        m_root = nullptr;
+        m_sentinel.m_furthest_node.fill(nullptr);
+        m_size = 0;
+        return root;
+      }
+
+      // makes detached subtree the content of empty tree, size may be unknown_size
+      void reset_root(NodeType* root, std::size_t size)
+      {
+        m_root = root;
+        m_size = size;
+        if (!m_root)
+          return;
+
+        for (auto direction : {left, right})
+          m_sentinel.m_furthest_node[direction] = m_root->furthest_node(direction);
+        m_sentinel.m_furthest_node[right]->append_child(right, make_sentinel());
+      }
+
+      // size of detached subtree if it's known in O(1)
+      static std::size_t known_size(const NodeType* root)
+      {
+        if (!root)
+          return 0;
+        if constexpr (detail::has_node_count<NodeType>::value)
+          return root->node_count();
+        else
+          return unknown_size;
+      }
+
+      // replaces content with perfectly balanced tree built from sorted range in O(n),
+      // visit(node, depth) is called for each created node
+      template <typename ForwardIt, typename Visitor>
+      void build_sorted(ForwardIt first, ForwardIt last, Visitor&& visit)
+      {
+        clear();
+        auto count = static_cast<std::size_t>(std::distance(first, last));
+        reset_root(build_sorted_subtree(first, count, 0, visit, m_allocator), count);
+        notify(tree_event::allocation, count);
+      }
+
+      // same as build_sorted but independent subtrees are built concurrently,
+      // each one with its own node allocator which is adopted by the tree afterwards,
+      // visit has to be safe to call concurrently
+      template <typename RandomIt, typename Visitor>
+      void build_sorted_parallel(RandomIt first, RandomIt last, Visitor&& visit, unsigned thread_count)
+      {
+        clear();
+        auto count = static_cast<std::size_t>(last - first);
+        std::deque<build_task_t<RandomIt>> tasks;
+        std::vector<NodeType *> top_nodes;
+        m_root = split_build(first, count, 0, visit, nullptr, none, std::max(thread_count, 1u), tasks, top_nodes);
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < tasks.size(); ++i)
+          threads.emplace_back([&task = tasks[i], &visit, this] { run_build_task(task, visit); });
+        if (!tasks.empty())
+          run_build_task(tasks.front(), visit);
+        for (auto& thread : threads)
+          thread.join();
+
+        for (auto& task : tasks)
+        {
+          if (task.parent && task.result)
+            task.parent->append_child(task.direction, task.result);
+          else if (!task.parent)
+            m_root = task.result;
+          m_allocator.adopt(std::move(task.allocator));
+        }
+        // top nodes are in pre-order, so reversed order visits children first
+        for (auto it = top_nodes.rbegin(); it != top_nodes.rend(); ++it)
+          (*it)->recalculate();
+        reset_root(m_root, count);
+        notify(tree_event::allocation, count);
+      }
+
+      template <typename... ArgTypes>
+      NodeType* create_node(ArgTypes&&... args)
+      {
+        notify(tree_event::allocation);
+        return m_allocator.create(std::forward<ArgTypes>(args)...);
+      }
+
+      template <typename ArgType>
+      NodeType* preinsert(ArgType&& key)
+      {
+        return link_node(create_node(std::forward<ArgType>(key)));
+      }
+
+      template <typename ArgType>
+      NodeType* preinsert(iterator_t hint, ArgType&& key)
+      {
+        return link_node(hint, create_node(std::forward<ArgType>(key)));
+      }
+
+      // links detached childless node below the leaf where its key belongs
+      NodeType* link_node(NodeType* node)
+      {
+        NodeType* parent = nullptr;
+        auto direction = left;
+        for (auto current = m_root; current; current = current->child(direction))
+        {
+          parent = current;
+          direction = key_less(node->key(), current->key()) ? left : right;
+        }
+        return attach(parent, direction, node);
+      }
+
+      // links node right before hint without descending from the root if its key belongs there
+      NodeType* link_node(iterator_t hint, NodeType* node)
+      {
+        auto next = is_sentinel(hint.m_node_ptr) ? nullptr : static_cast<NodeType*>(hint.m_node_ptr);
+        auto prev = next ? next->next_node(left) : m_sentinel.m_furthest_node[right];
+        if (!m_root || (next && key_less(next->key(), node->key())) || (prev && key_less(node->key(), prev->key())))
+          return link_node(node);
+
+        // either next has no left child or prev is the rightmost node of that subtree
+        if (next && !next->child(left))
+          return attach(next, left, node);
+        return attach(prev, right, node);
+      }
+
+      // links detached childless node as child of parent, which has to be free, or as the root
+      NodeType* attach(NodeType* parent, direction_t direction, NodeType* node)
+      {
+        if (!parent)
+          m_root = node;
+        else
+          parent->append_child(direction, node);
+
+        for (auto furthest_node_dir : {left, right})
+          if (m_sentinel.m_furthest_node[furthest_node_dir] == nullptr ||
+            node == m_sentinel.m_furthest_node[furthest_node_dir]->child(furthest_node_dir))
+          {
+            m_sentinel.m_furthest_node[furthest_node_dir] = node;
+            if (furthest_node_dir == right)
+              m_sentinel.m_furthest_node[furthest_node_dir]->append_child(right, make_sentinel ());
+          }
+        node->recalculate_upwards();
+        if (m_size != unknown_size)
+          ++m_size;
+        if constexpr (has_event_listeners)
+          notify(tree_event::insertion, node_depth(node));
+        return node;
+      }
+
+      // takes ownership of the node held by handle, it has to come from a tree sharing the allocator
+      // unless nodes are transferable
+      NodeType* release_handle(node_handle_t&& handle)
+      {
+        assert (node_allocator_t::transferable_nodes || handle.m_allocator == &m_allocator);
+        handle.m_allocator->take_back();
+        return std::exchange(handle.m_node, nullptr);
+      }
+
+      node_handle_t make_handle(NodeType* node)
+      {
+        m_allocator.hand_out();
+        return {node, &m_allocator};
+      }
+
+      // prepares removal of node, returning it with at most one child
+      NodeType* preerase_node(NodeType* node)
+      {
+        notify(tree_event::erasure);
+        if (m_size != unknown_size)
+          --m_size;
+        if (node->child_count() == 2)
+          swap_with_predecessor(node);
+        return node;
+      }
+
+      static NodeType* node_of(iterator_t position)
+      {
+        assert (!is_sentinel(position.m_node_ptr));
+        return static_cast<NodeType*>(position.m_node_ptr);
+      }
+
+      template <typename ArgType>
+      NodeType* preerase(const ArgType& key)
+      {
+        auto node = find_node(key);
+        if (!node)
+          return nullptr;
+        return preerase_node(node);
+      }
+
+    private:
+      void copy_from(const tree_t& other)
+      {
+        (static_cast<void>(static_cast<typename Plugins<NodeType>::template tree_t<tree_t>&>(*this) =
+                           static_cast<const typename Plugins<NodeType>::template tree_t<tree_t>&>(other)), ...);
+        if (!other.m_root)
+          return;
+
+        auto count = other.size();
+        m_allocator.reserve(count);
+        auto copy_node = [this](const NodeType* node)
+        {
+          auto copy = m_allocator.create(node->key());
+          copy->set_parent_tag(node->parent_tag());
+          (static_cast<void>(static_cast<typename Plugins<NodeType>::node_t&>(*copy) =
+                             static_cast<const typename Plugins<NodeType>::node_t&>(*node)), ...);
+          return copy;
+        };
+
+        // pre-order walk through parent links, so degenerate trees don't exhaust the stack;
+        // if a key copy throws, nodes copied so far are destroyed and the tree stays empty
+        NodeType* root = nullptr;
+        try
+        {
+          const NodeType* source = other.m_root;
+          auto target = root = copy_node(source);
+          while (true)
+          {
+            auto direction = !target->child(left) && source->child(left) ? left
+                           : !target->child(right) && source->child(right) ? right : none;
+            if (direction != none)
+            {
+              source = source->child(direction);
+              target = target->append_child(direction, copy_node(source));
+            }
+            else if (source == other.m_root)
+              break;
+            else
+            {
+              source = source->parent();
+              target = target->parent();
+            }
+          }
+        }
+        catch (...)
+        {
+          dismantle(root, [this](NodeType* node) { m_allocator.destroy(node); });
+          throw;
+        }
+        reset_root(root, count);
+        notify(tree_event::allocation, count);
+      }
+
+      // exchanges places and balancing tags of node having two children and its in-order predecessor,
+      // keys stay in their nodes so iterators to both remain valid
+      void swap_with_predecessor(NodeType* node)
+      {
+        auto relink = [](NodeType* parent, direction_t direction, NodeType* child)
+        {
+          parent->m_children[direction] = child;
+          if (child)
+            child->set_parent(parent);
+        };
+
+        auto predecessor = node->child(left)->furthest_node(right);
+        auto parent = node->parent();
+        auto direction = parent ? node->direction_from_parent() : left;
+        auto predecessor_parent = predecessor->parent();
+        auto predecessor_left = predecessor->child(left);
+        auto node_tag = node->parent_tag();
+        auto predecessor_tag = predecessor->parent_tag();
+
+        if (parent)
+          relink(parent, direction, predecessor);
+        else
+        {
+          m_root = predecessor;
+          predecessor->set_parent(nullptr);
+        }
+        relink(predecessor, right, node->child(right));
+        if (predecessor_parent == node)
+          relink(predecessor, left, node);
+        else
+        {
+          relink(predecessor, left, node->child(left));
+          relink(predecessor_parent, right, node);
+        }
+        relink(node, left, predecessor_left);
+        node->m_children[right] = nullptr;
+
+        node->set_parent_tag(predecessor_tag);
+        predecessor->set_parent_tag(node_tag);
+      }
+
+      iterator_t to_iterator(NodeType* node)
+      {
+        if (!node)
+          return end();
+        return {node};
+      }
+
+      // leftmost node satisfying predicate which has to be monotonic in key order
+      template <typename Predicate>
+      NodeType* first_node_where(Predicate predicate) const
+      {
+        notify(tree_event::lookup);
+        NodeType* found = nullptr;
+        for (auto current = m_root; current;)
+        {
+          if (predicate(current->key()))
+          {
+            found = current;
+            current = current->child(left);
+          }
+          else
+            current = current->child(right);
+        }
+        return found;
+      }
+
+      template <typename ArgType>
+      NodeType* find_node(const ArgType& key) const
+      {
+        notify(tree_event::lookup);
+        auto current = m_root;
+        while (current)
+        {
+          if (key_less(key, current->key()))
+            current = current->child(left);
+          else if (key_less(current->key(), key))
+            current = current->child(right);
+          else
+            return current;
+        }
+        return nullptr;
+      }
+
+      void relink_sentinel ()
+      {
+        if (m_root)
+          m_sentinel.m_furthest_node[right]->m_children[right] = make_sentinel ();
+      }
+
+      base_node_t* make_sentinel ()
+      {
+        return sentinel_link(&m_sentinel);
+      }
+
+      // consumes count elements from it in order, children are attached bottom-up
+      // so plugins only update the subtree being built
+      template <typename ForwardIt, typename Visitor>
+      static NodeType* build_sorted_subtree(ForwardIt& it, std::size_t count, int depth, Visitor& visit, node_allocator_t& allocator)
+      {
+        if (count == 0)
+          return nullptr;
+
+        auto left_count = (count - 1) / 2;
+        auto left_subtree = build_sorted_subtree(it, left_count, depth + 1, visit, allocator);
+        auto node = allocator.create(*it);
+        ++it;
+        visit(node, depth);
+        if (left_subtree)
+          node->append_child(left, left_subtree);
+        if (auto right_subtree = build_sorted_subtree(it, count - 1 - left_count, depth + 1, visit, allocator))
+          node->append_child(right, right_subtree);
+        node->recalculate();
+        return node;
+      }
+
+      template <typename RandomIt>
+      struct build_task_t
+      {
+        build_task_t(RandomIt first_arg, std::size_t count_arg, int depth_arg, NodeType* parent_arg, direction_t direction_arg)
+          : first(first_arg), count(count_arg), depth(depth_arg), parent(parent_arg), direction(direction_arg) {}
+
+        RandomIt first;
+        std::size_t count;
+        int depth;
+        NodeType* parent;
+        direction_t direction;
+        NodeType* result = nullptr;
+        node_allocator_t allocator;
+      };
+
+      // builds top levels of the tree until there's enough subtrees for every thread
+      template <typename RandomIt, typename Visitor>
+      NodeType* split_build(RandomIt first, std::size_t count, int depth, Visitor& visit,
+                            NodeType* parent, direction_t direction, unsigned thread_count,
+                            std::deque<build_task_t<RandomIt>>& tasks, std::vector<NodeType *>& top_nodes)
+      {
+        if (thread_count <= 1 || count < detail::parallel_cutoff)
+        {
+          tasks.emplace_back(first, count, depth, parent, direction);
+          return nullptr;
+        }
+
+        auto left_count = (count - 1) / 2;
+        auto node = m_allocator.create(first[left_count]);
+        visit(node, depth);
+        top_nodes.push_back(node);
+        if (auto left_subtree = split_build(first, left_count, depth + 1, visit, node, left, thread_count / 2, tasks, top_nodes))
+          node->append_child(left, left_subtree);
+        if (auto right_subtree = split_build(first + (left_count + 1), count - 1 - left_count, depth + 1, visit,
+                                             node, right, thread_count - thread_count / 2, tasks, top_nodes))
+          node->append_child(right, right_subtree);
+        return node;
+      }
+
+      template <typename RandomIt, typename Visitor>
+      static void run_build_task(build_task_t<RandomIt>& task, Visitor& visit)
+      {
+        auto it = task.first;
+        task.result = build_sorted_subtree(it, task.count, task.depth, visit, task.allocator);
+      }
+
+      // walks below go through parent links or restructure the subtree, so unbalanced trees don't exhaust the stack
+      static std::size_t count_nodes (const NodeType* root)
+      {
+        std::size_t count = 0;
+        for (auto node = root; node; node = next_preorder (node, root))
+          ++count;
+        return count;
+      }
+
+      // node following node in pre-order of subtree of root, nullptr after the last one
+      static const NodeType* next_preorder (const NodeType* node, const NodeType* root)
+      {
+        for (auto direction : {left, right})
+          if (auto child = node->child (direction))
+            return child;
+        for (; node != root; node = node->parent ())
+        {
+          auto parent = node->parent ();
+          if (parent->child (left) == node && parent->child (right))
+            return parent->child (right);
+        }
+        return nullptr;
+      }
+
+      void destroy_subtree (NodeType* node)
+      {
+        dismantle (node, [this] (NodeType* destroyed) { destroy_node (destroyed); });
+      }
+
+    protected:
+      // destroys every node of subtree, left children are rotated into the right spine first
+      template <typename Destroy>
+      static void dismantle (NodeType* node, Destroy destroy)
+      {
+        while (node)
+        {
+          if (auto child = node->child (left))
+          {
+            node->m_children[left] = child->child (right);
+            child->m_children[right] = node;
+            node = child;
+          }
+          else
+          {
+            auto next = node->child (right);
+            destroy (node);
+            node = next;
+          }
+        }
+      }
+
+    private:
+      static std::size_t node_depth (const NodeType* node)
+      {
+        std::size_t depth = 0;
+        for (; node->parent (); node = node->parent ())
+          ++depth;
+        return depth;
+      }
+
+      template <typename PluginTree>
+      void notify_plugin (tree_event event, std::size_t value) const
+      {
+        if constexpr (detail::has_event_hook<PluginTree>::value)
+          static_cast<const PluginTree *> (this)->on_event (event, value);
+      }
+
+    private:
+      sentinel_t m_sentinel;
+      std::size_t m_size;
+      NodeType* m_root = nullptr;
+      node_allocator_t m_allocator;
+
+      template <typename, template <typename> class...>
+      friend struct rb_tree_container;
+      friend class iterator_t;
+    };
+  };
+
+  template <typename KeyType, template<typename> class... Plugins>
+  struct rb_tree_container
+  {
+    class tree_t;
+
+    struct node_t : btree_container<KeyType, node_t, Plugins...>::node_t
+    {
+      using parent_t = typename btree_container<KeyType, node_t, Plugins...>::node_t;
+      using parent_t::parent_t;
+    public:
+      auto color() const { return static_cast<color_t>(this->parent_tag()); }
+
+      auto child_color(direction_t direction) const
+      {
+        if (!this->child(direction))
+          return color_t::black;
 
-        return this->child(dir);
+        return this->child(direction)->color();
       }
 
     private:
-      std::array<node_storage_t, 2> m_children;
-      NodeType* m_parent = nullptr;
-      KeyType m_key;
+      // color is stored in the parent pointer, new nodes are red
+      void paint(color_t value) { this->set_parent_tag(static_cast<unsigned>(value)); }
 
       friend class tree_t;
-      friend class iterator_t;
     };
 
-    class iterator_t
+    class tree_t : public btree_container<KeyType, typename rb_tree_container::node_t, Plugins...>::tree_t
     {
-      using node_type = NodeType;
-      using self = iterator_t;
+      // red black tree with indexation by log n
+      using self = tree_t;
+      using base = typename btree_container<KeyType, typename rb_tree_container::node_t, Plugins...>::tree_t;
     public:
-      using iterator_category = std::bidirectional_iterator_tag;
-      using reference = const KeyType &;
-      using pointer = const KeyType *;
-      using value_type = const KeyType;
-      using difference_type = std::size_t;
+      using node_t = typename rb_tree_container::node_t;
+    private:
+      using node_allocator_t = typename btree_container<KeyType, node_t, Plugins...>::node_allocator_t;
     public:
-      iterator_t(base_node_t* node) : m_node_ptr(node)
+
+      tree_t () : base () {}
+      ~tree_t () {}
+
+      tree_t (const tree_t &) = default;
+      tree_t &operator= (const tree_t &) = default;
+      tree_t (tree_t &&) noexcept = default;
+      tree_t &operator= (tree_t &&) noexcept = default;
+
+      friend void swap (tree_t &lhs, tree_t &rhs) noexcept { lhs.swap (rhs); }
+
+      // [first, last) has to be sorted, builds the tree in O(n) without rebalancing
+      template <typename ForwardIt>
+      void assign_sorted(ForwardIt first, ForwardIt last)
       {
+        this->build_sorted(first, last, painter(static_cast<std::size_t>(std::distance(first, last))));
       }
 
-      self& operator++()
+      // replaces content with keys stored by write() in O(n), e.g. from a memory mapped file,
+      // false and no change if data doesn't hold sorted keys of KeyType or isn't aligned for them
+      bool load(const void* data, std::size_t bytes)
       {
-        auto next_node = get_node()->next_node(right);
-        if (next_node == nullptr)
+        constexpr auto offset = detail::tree_file_keys_offset<KeyType>;
+        if (bytes < offset)
+          return false;
+        auto count = detail::read_tree_file_header<KeyType>(data);
+        auto keys = static_cast<const char *>(data) + offset;
+        if (!count || *count > (bytes - offset) / sizeof(KeyType) || reinterpret_cast<std::uintptr_t>(keys) % alignof(KeyType) != 0)
+          return false;
+        auto first = reinterpret_cast<const KeyType *>(keys);
+        return load_sorted(first, first + *count);
+      }
+
+      // same as load(data, bytes) for a stream positioned at the header,
+      // keys are read in chunks so a corrupted count fails at the end of the stream
+      bool load(std::istream& stream)
+      {
+        char header[detail::tree_file_keys_offset<KeyType>];
+        if (!stream.read(header, sizeof(header)))
+          return false;
+        auto count = detail::read_tree_file_header<KeyType>(header);
+        if (!count)
+          return false;
+
+        const std::size_t chunk_size = std::max<std::size_t>(1, (std::size_t(1) << 16) / sizeof(KeyType));
+        std::vector<KeyType> keys;
+        while (keys.size() < *count)
         {
-          m_node_ptr = get_node()->m_children[right].get ();
-          assert (m_node_ptr->is_sentinel);
+          auto read_count = std::min(chunk_size, *count - keys.size());
+          keys.resize(keys.size() + read_count);
+          auto destination = reinterpret_cast<char *>(keys.data() + keys.size() - read_count);
+          if (!stream.read(destination, static_cast<std::streamsize>(read_count * sizeof(KeyType))))
+            return false;
         }
-        else
-          m_node_ptr = next_node;
-        return *this;
+        return load_sorted(keys.begin(), keys.end());
       }
 
-      self& operator--()
+      // replaces content with unique keys from arbitrary range, sorting and building the tree
+      // is spread among thread_count threads
+      template <typename InputIt>
+      void assign(InputIt first, InputIt last, unsigned thread_count = detail::default_thread_count())
       {
-        if (!m_node_ptr->is_sentinel)
-          m_node_ptr = get_node()->next_node(left);
-        else
-          m_node_ptr = get_tree()->furthest_node(right);
-
-        return *this;
+        std::vector<KeyType> keys(first, last);
+        {
+          std::vector<KeyType> buffer(keys.size());
+          detail::parallel_sort(keys.begin(), keys.end(), buffer.begin(), thread_count);
+        }
+        keys.erase(std::unique(keys.begin(), keys.end(), [](const KeyType& lhs, const KeyType& rhs) { return !(lhs < rhs); }), keys.end());
+        this->build_sorted_parallel(std::make_move_iterator(keys.begin()), std::make_move_iterator(keys.end()),
+                                    painter(keys.size()), thread_count);
       }
 
-      reference operator*()
+      template <typename ArgType>
+      void insert(ArgType&& key)
       {
-        return get_node()->key();
+        fix_after_insert(this->preinsert(std::forward<ArgType>(key)));
       }
 
-      bool operator==(const self& other)
+      // inserts key as close as possible before hint, in amortized O(1) if it belongs right there
+      template <typename ArgType>
+      typename base::iterator insert(typename base::iterator hint, ArgType&& key)
       {
-        return m_node_ptr == other.m_node_ptr;
+        auto node = this->preinsert(hint, std::forward<ArgType>(key));
+        fix_after_insert(node);
+        return {node};
       }
 
-      bool operator!=(const self& other)
+      // [first, last) has to be sorted, each key is linked next to the previous one,
+      // so a run above the current maximum is ingested in amortized O(1) per key
+      template <typename InputIt>
+      void append_sorted(InputIt first, InputIt last)
       {
-        return !(*this == other);
+        auto hint = this->end();
+        for (; first != last; ++first)
+        {
+          // the hint stays at end() while keys extend the maximum, stepping past it would climb the right spine
+          auto position = insert(hint, *first);
+          if (base::node_of(position) != this->furthest_node(right))
+          {
+            hint = position;
+            ++hint;
+          }
+        }
       }
 
-    private:
-      node_t* get_node() const
+      // constructs the key in a new node from args
+      template <typename... ArgTypes>
+      typename base::iterator emplace(ArgTypes&&... args)
       {
-        assert (!m_node_ptr->is_sentinel);
-        return static_cast<node_t *>(m_node_ptr);
+        auto node = this->link_node(this->create_node(std::forward<ArgTypes>(args)...));
+        fix_after_insert(node);
+        return {node};
       }
 
-      tree_t* get_tree() const
+      // takes the node out of the tree without destroying it, other iterators stay valid
+      typename base::node_handle extract(typename base::iterator position)
       {
-        assert (m_node_ptr->is_sentinel);
-        return static_cast<sentinel_t *>(m_node_ptr)->m_tree_ptr;
+        auto node = this->preerase_node(base::node_of(position));
+        unlink(node);
+        return this->make_handle(node);
       }
 
-    private:
-      base_node_t* m_node_ptr;
-    };
-
-    class tree_t : public Plugins<NodeType>::template tree_t<tree_t>...
-    {
-      using self = tree_t;
-    public:
-      using iterator = iterator_t;
-
-      tree_t () : m_sentinel (this), m_size (0), m_root (nullptr, &delete_node)
+      // empty handle if there is no such key
+      template <typename ArgType>
+      typename base::node_handle extract(const ArgType& key)
       {
-
+        auto position = this->find(key);
+        if (position == this->end())
+          return {};
+        return extract(position);
       }
 
-      iterator_t begin()
+      // links the node owned by handle back without allocation, end() for empty handle;
+      // a pooled node linked into any tree other than the one it was extracted from is undefined behavior,
+      // which only debug builds catch
+      typename base::iterator insert(typename base::node_handle&& handle)
       {
-        return {m_root ? furthest_node(left) : nullptr};
+        if (handle.empty())
+          return this->end();
+
+        auto node = static_cast<node_t*>(this->release_handle(std::move(handle)));
+        node->paint(color_t::red);
+        this->link_node(node);
+        fix_after_insert(node);
+        return {node};
       }
 
-      iterator_t end()
+      template <typename ArgType>
+      std::size_t erase(const ArgType& key)
       {
-        return {&m_sentinel};
-      }
+        auto m = this->preerase(key);
+        if (!m)
+          return 0;
 
+        unlink(m);
+        this->destroy_node(m);
+        return 1;
+      }
 
-      void clear()
+      // returns iterator following the erased key, iterators to other keys stay valid
+      typename base::iterator erase(typename base::iterator position)
       {
-        m_root.reset();
-        m_furthest_node.fill (nullptr);
-        m_size = 0;
+        auto next = position;
+        ++next;
+        auto node = this->preerase_node(base::node_of(position));
+        unlink(node);
+        this->destroy_node(node);
+        return next;
       }
 
-      node_storage_t take_out(NodeType* node)
+      typename base::iterator erase(typename base::iterator first, typename base::iterator last)
       {
-        if (node->parent())
-          return node->take_out();
-        else
-          return std::move(m_root);
+        while (first != last)
+          first = erase(first);
+        return last;
       }
 
-      void replace_with_child(NodeType* node)
+      // moves keys not less than key to right_tree (its previous content is dropped), in O(log n)
+      // without node_count() sizes of both trees are unknown afterwards, see size() and recount()
+      template <typename ArgType>
+      void split(const ArgType& key, tree_t& right_tree)
       {
-        auto cnt = node->child_count();
-        auto direction = node->direction_from_parent();
-        auto parent = node->parent();
-        auto taken_out = take_out(node);
-        auto update_furthest_nodes =
-        [&]()
-        {
-          for (auto furthest_node_dir : {left, right})
-            if (node == m_furthest_node[furthest_node_dir])
-              {
-                if (parent)
-                  {
-                    if (auto child = parent->child (furthest_node_dir))
-                      m_furthest_node[furthest_node_dir] = child;
-                    else
-                      m_furthest_node[furthest_node_dir] = parent;
-                  }
-                else
-                  m_furthest_node[furthest_node_dir] = static_cast<NodeType *> (m_root.get ());
-                if (furthest_node_dir == right && m_furthest_node[right])
-                  m_furthest_node[right]->append_child (right, make_sentinel());
-              }
-        };
-
-        if (cnt == 0)
-        {
-          update_furthest_nodes ();
+        static_assert (node_allocator_t::transferable_nodes, "nodes of pooled tree can't be moved to another tree");
+        right_tree.clear();
+        auto root = this->release_nodes();
+        if (!root)
           return;
-        }
-        if (parent)
-          parent->append_child(direction, take_out(node->single_child()));
-        else
-          m_root = node->single_child()->take_out();
-        update_furthest_nodes ();
+
+        auto parts = split_subtree(root, black_height(root), key);
+        this->reset_root(parts.first.root, base::known_size(parts.first.root));
+        right_tree.reset_root(parts.second.root, base::known_size(parts.second.root));
       }
 
-      void rotate(NodeType* node, direction_t dir)
+      // set operations keep the result in this tree and leave other empty, keys are relinked rather than copied,
+      // both trees have to hold unique keys; independent halves are processed by up to thread_count threads
+      void union_of(tree_t& other, unsigned thread_count = detail::default_thread_count())
       {
-        auto prev_parent = node->parent();
-        direction_t prev_direction;
-        if (prev_parent)
-          prev_direction = node->direction_from_parent();
-        auto hanging_node = take_out(node);
-        auto heritor = take_out(node->child(other_direction(dir)));
-        auto heritor_ptr = static_cast<NodeType *> (heritor.get ());
-        if (heritor_ptr->child(dir))
-          node->append_child(other_direction(dir), take_out(heritor_ptr->child(dir)));
-
-        heritor_ptr->append_child(dir, std::move(hanging_node));
-        if (prev_parent)
-          prev_parent->append_child(prev_direction, std::move(heritor));
-        else
-          m_root = std::move(heritor);
+        combine_with(other, union_subtrees, thread_count,
+                     [](std::size_t lhs_size, std::size_t rhs_size, std::size_t shared) { return lhs_size + rhs_size - shared; });
       }
 
-      template <typename ArgType>
-      std::size_t erase(const ArgType& key)
+      void intersection_of(tree_t& other, unsigned thread_count = detail::default_thread_count())
       {
-        auto current = preerase(key);
-        if (!current)
-          return 0;
+        combine_with(other, intersection_subtrees, thread_count, [](std::size_t, std::size_t, std::size_t shared) { return shared; });
+      }
 
-        replace_with_child(current);
-        return 1;
+      // removes keys present in other
+      void difference_of(tree_t& other, unsigned thread_count = detail::default_thread_count())
+      {
+        combine_with(other, difference_subtrees, thread_count,
+                     [](std::size_t lhs_size, std::size_t, std::size_t shared) { return lhs_size - shared; });
       }
 
-      std::size_t size() const { return m_size; }
+      // appends all keys of right_tree which have to be not less than keys of this tree, in O(log n)
+      void join(tree_t& right_tree)
+      {
+        if (!right_tree.m_root)
+          return;
 
-      const NodeType* root() const { return static_cast<NodeType *> (m_root.get()); }
+        auto size = this->m_size == base::unknown_size || right_tree.m_size == base::unknown_size
+          ? base::unknown_size : this->m_size + right_tree.m_size;
+        auto middle = right_tree.furthest_node(left);
+        right_tree.unlink(middle);
+        auto right_root = right_tree.release_nodes();
+        this->m_allocator.adopt(std::move(right_tree.m_allocator));
+
+        auto left_root = this->release_nodes();
+        auto joined = join_subtrees({left_root, black_height(left_root)}, middle, {right_root, black_height(right_root)});
+        this->reset_root(joined.root, size);
+      }
 
     protected:
-      NodeType* furthest_node(direction_t direction)
+      // detached red black subtree with black root
+      struct subtree_t
+      {
+        node_t* root;
+        int black_height;
+      };
+
+      static int black_height(const node_t* node)
       {
-        return m_furthest_node[direction];
+        int height = 0;
+        for (; node; node = node->child(left))
+          height += (node->color() == color_t::black);
+        return height;
       }
 
-      template <typename ArgType>
-      NodeType* preinsert(ArgType&& key)
+      // detaches child subtree of node with given black height, painting its root black
+      static subtree_t take_out_child(node_t* node, int node_height, direction_t direction)
       {
-        auto create_node = [](auto&& key)
+        auto child = node->child(direction);
+        int height = node_height - (node->color() == color_t::black);
+        if (!child)
+          return {nullptr, height};
+
+        child->take_out();
+        if (child->color() == color_t::red)
         {
-          auto node = make_node (std::forward<ArgType>(key));
-          return node;
-        };
+          child->paint(color_t::black);
+          ++height;
+        }
+        return {child, height};
+      }
 
-        auto current = static_cast<NodeType *> (m_root.get());
-        if (!current)
+      // joins subtrees with childless detached middle node between them in O(difference of black heights)
+      static subtree_t join_subtrees(subtree_t lhs, node_t* middle, subtree_t rhs)
+      {
+        if (lhs.black_height == rhs.black_height)
         {
-          m_root = create_node(std::forward<ArgType>(key));
-          current = static_cast<NodeType *> (m_root.get());
+          if (lhs.root)
+            middle->append_child(left, lhs.root);
+          if (rhs.root)
+            middle->append_child(right, rhs.root);
+          middle->paint(color_t::black);
+          middle->recalculate();
+          return {middle, lhs.black_height + 1};
         }
-        else
+
+        // middle goes down the inner spine of the taller subtree until black heights match
+        auto direction = lhs.black_height > rhs.black_height ? right : left;
+        auto taller = direction == right ? lhs : rhs;
+        auto shorter = direction == right ? rhs : lhs;
+        auto current = taller.root;
+        node_t* parent = nullptr;
+        int height = taller.black_height;
+        while (current && (current->color() == color_t::red || height > shorter.black_height))
         {
-          while (true)
-          {
-            auto check_child = [&](direction_t direction)
-            {
-              if (!current->child(direction))
-              {
-                current = current->append_child(direction, create_node(std::forward<ArgType>(key)));
-                return true;
-              }
+          height -= (current->color() == color_t::black);
+          parent = current;
+          current = current->child(direction);
+        }
 
-              current = current->child(direction);
-              return false;
-            };
+        if (current)
+          middle->append_child(other_direction(direction), current->take_out());
+        if (shorter.root)
+          middle->append_child(direction, shorter.root);
+        middle->paint(color_t::red);
+        parent->append_child(direction, middle);
+        middle->recalculate_upwards();
+
+        // rebalancing rotates through m_root, so it runs on a scratch tree owned by the calling thread
+        tree_t workspace;
+        workspace.m_root = taller.root;
+        auto grown = workspace.fix_after_insert(middle);
+        subtree_t result {workspace.m_root, taller.black_height + (grown ? 1 : 0)};
+        workspace.m_root = nullptr;
+        return result;
+      }
 
-            if (key < current->key())
-            {
-              if (check_child(left))
-                break;
-            }
-            else
-            {
-              if (check_child(right))
-                break;
-            }
-          }
-        }
-        for (auto direction : {left, right})
-          if (m_furthest_node[direction] == nullptr ||
-            current == m_furthest_node[direction]->child(direction))
-          {
-            m_furthest_node[direction] = current;
-            if (direction == right)
-              m_furthest_node[direction]->append_child(right, make_sentinel ());
-          }
-        ++m_size;
-        return current;
+      // joins subtrees without middle node, borrowing the minimum of rhs
+      static subtree_t join_subtrees(subtree_t lhs, subtree_t rhs)
+      {
+        if (!lhs.root)
+          return rhs;
+        if (!rhs.root)
+          return lhs;
+
+        tree_t workspace;
+        workspace.m_root = rhs.root;
+        auto middle = rhs.root->furthest_node(left);
+        workspace.unlink(middle);
+        auto rest = workspace.m_root;
+        workspace.m_root = nullptr;
+        if (rest && rest->color() == color_t::red)
+          rest->paint(color_t::black);
+        return join_subtrees(lhs, middle, {rest, black_height(rest)});
       }
 
+      // splits detached subtree with black root into keys less than key and the rest,
+      // if found is given a node equal to key is taken out into it instead, keys have to be unique then
       template <typename ArgType>
-      NodeType* preerase(const ArgType& key)
+      static std::pair<subtree_t, subtree_t> split_subtree(node_t* root, int height, const ArgType& key, node_t** found = nullptr)
       {
-        if (!m_root)
-          return nullptr;
+        if (!root)
+          return {{nullptr, 0}, {nullptr, 0}};
 
-        auto current = static_cast<NodeType *> (m_root.get());
-        while (current)
+        auto lhs = take_out_child(root, height, left);
+        auto rhs = take_out_child(root, height, right);
+        if (root->key() < key)
         {
-          if (key < current->key())
-            current = current->child(left);
-          else if (key > current->key())
-            current = current->child(right);
-          else
-            break;
+          auto parts = split_subtree(rhs.root, rhs.black_height, key, found);
+          return {join_subtrees(lhs, root, parts.first), parts.second};
+        }
+        if (found && !(key < root->key()))
+        {
+          root->paint(color_t::black);
+          *found = root;
+          return {lhs, rhs};
         }
 
-        if (!current)
-          return nullptr;
-
-        --m_size;
-
-        auto cnt = current->child_count();
-        if (cnt <= 1)
-          return current;
-
-        auto child = current->child(left);
-        while (auto next_child = child->child(right))
-          child = next_child;
-
-        current->m_key = child->m_key;
-        return child;
+        auto parts = split_subtree(lhs.root, lhs.black_height, key, found);
+        return {parts.first, join_subtrees(parts.second, root, rhs)};
       }
 
     private:
-      node_storage_t make_sentinel ()
+      // nodes are transferable, so any allocator of the same type may destroy them
+      static void destroy_detached(node_t* node)
       {
-        return node_storage_t (&this->m_sentinel, [](base_node_t*){});
+        node_allocator_t allocator;
+        base::dismantle(node, [&allocator](node_t* destroyed) { allocator.destroy(destroyed); });
       }
 
-    private:
-      sentinel_t m_sentinel;
-      size_t m_size;
-      std::array<NodeType *, 2> m_furthest_node = {nullptr, nullptr};
-      node_storage_t m_root;
-
-      friend struct rb_tree_container<KeyType>;
-      friend class iterator_t;
-    };
-  };
+      // black height h bounds subtree size by 4^h
+      static bool worth_forking(int black_height, unsigned thread_count)
+      {
+        return thread_count > 1 && black_height < 32 && (std::size_t(1) << (2 * black_height)) >= detail::parallel_cutoff;
+      }
 
-  template <typename KeyType, template<typename> class... Plugins>
-  struct rb_tree_container
-  {
-    class tree_t;
+      template <typename Func>
+      static std::pair<subtree_t, subtree_t> on_both_sides(Func&& func, int black_height, unsigned thread_count)
+      {
+        std::pair<subtree_t, subtree_t> results;
+        auto lhs_func = [&] { results.first = func(left, thread_count / 2); };
+        auto rhs_func = [&] { results.second = func(right, thread_count - thread_count / 2); };
+        if (worth_forking(black_height, thread_count))
+          detail::run_in_parallel(lhs_func, rhs_func);
+        else
+        {
+          lhs_func();
+          rhs_func();
+        }
+        return results;
+      }
 
-    struct node_t : btree_container<KeyType, node_t, Plugins...>::node_t
-    {
-      using parent_t = typename btree_container<KeyType, node_t, Plugins...>::node_t;
-      using parent_t::parent_t;
-    public:
-      auto color() const { return m_color; }
+      // the algorithms below expose root of rhs, split lhs by its key and recurse into both halves,
+      // which takes O(m log(n / m + 1)) work for sizes m <= n and O(log^2 n) span;
+      // keys found in both trees are counted in shared so that the size of the result is known
+      static subtree_t union_subtrees(subtree_t lhs, subtree_t rhs, unsigned thread_count, std::atomic<std::size_t>& shared)
+      {
+        if (!lhs.root)
+          return rhs;
+        if (!rhs.root)
+          return lhs;
+
+        auto middle = rhs.root;
+        subtree_t rhs_parts[] = {take_out_child(middle, rhs.black_height, left), take_out_child(middle, rhs.black_height, right)};
+        node_t* duplicate = nullptr;
+        auto lhs_parts = split_subtree(lhs.root, lhs.black_height, middle->key(), &duplicate);
+        count_shared(duplicate, shared);
+        destroy_detached(duplicate);
+        auto results = on_both_sides([&](direction_t direction, unsigned threads) {
+            return union_subtrees(direction == left ? lhs_parts.first : lhs_parts.second, rhs_parts[direction], threads, shared);
+          }, rhs.black_height, thread_count);
+        return join_subtrees(results.first, middle, results.second);
+      }
 
-      auto child_color(direction_t direction) const
+      static subtree_t intersection_subtrees(subtree_t lhs, subtree_t rhs, unsigned thread_count, std::atomic<std::size_t>& shared)
       {
-        if (!this->child(direction))
-          return color_t::black;
+        if (!lhs.root || !rhs.root)
+        {
+          destroy_detached(lhs.root);
+          destroy_detached(rhs.root);
+          return {nullptr, 0};
+        }
 
-        return this->child(direction)->color();
+        auto middle = rhs.root;
+        subtree_t rhs_parts[] = {take_out_child(middle, rhs.black_height, left), take_out_child(middle, rhs.black_height, right)};
+        node_t* duplicate = nullptr;
+        auto lhs_parts = split_subtree(lhs.root, lhs.black_height, middle->key(), &duplicate);
+        count_shared(duplicate, shared);
+        auto results = on_both_sides([&](direction_t direction, unsigned threads) {
+            return intersection_subtrees(direction == left ? lhs_parts.first : lhs_parts.second, rhs_parts[direction], threads, shared);
+          }, rhs.black_height, thread_count);
+        if (!duplicate)
+        {
+          destroy_detached(middle);
+          return join_subtrees(results.first, results.second);
+        }
+        destroy_detached(duplicate);
+        return join_subtrees(results.first, middle, results.second);
       }
 
-    private:
-      color_t m_color = color_t::red;
-      void paint(color_t value) { m_color = value; }
+      static subtree_t difference_subtrees(subtree_t lhs, subtree_t rhs, unsigned thread_count, std::atomic<std::size_t>& shared)
+      {
+        if (!lhs.root || !rhs.root)
+        {
+          destroy_detached(rhs.root);
+          return lhs;
+        }
 
-      friend class tree_t;
-    };
+        auto middle = rhs.root;
+        subtree_t rhs_parts[] = {take_out_child(middle, rhs.black_height, left), take_out_child(middle, rhs.black_height, right)};
+        node_t* duplicate = nullptr;
+        auto lhs_parts = split_subtree(lhs.root, lhs.black_height, middle->key(), &duplicate);
+        count_shared(duplicate, shared);
+        destroy_detached(duplicate);
+        destroy_detached(middle);
+        auto results = on_both_sides([&](direction_t direction, unsigned threads) {
+            return difference_subtrees(direction == left ? lhs_parts.first : lhs_parts.second, rhs_parts[direction], threads, shared);
+          }, rhs.black_height, thread_count);
+        return join_subtrees(results.first, results.second);
+      }
 
-    class tree_t : public btree_container<KeyType, node_t, Plugins...>::tree_t
-    {
-      // red black tree with indexation by log n
-      using self = tree_t;
-      using base = typename btree_container<KeyType, node_t, Plugins...>::tree_t;
-    public:
-      using node_t = node_t;
-    public:
+      static void count_shared(const node_t* duplicate, std::atomic<std::size_t>& shared)
+      {
+        if (duplicate)
+          shared.fetch_add(1, std::memory_order_relaxed);
+      }
 
-      tree_t () : base () {}
-      ~tree_t () {}
+      // result size follows from sizes of both trees and the number of shared keys, unless split left one unknown
+      template <typename Operation, typename ResultSize>
+      void combine_with(tree_t& other, Operation operation, unsigned thread_count, ResultSize result_size)
+      {
+        static_assert (node_allocator_t::transferable_nodes, "nodes of pooled tree can't be moved to another tree");
+        auto lhs_size = this->m_size;
+        auto rhs_size = other.m_size;
+        auto lhs_root = this->release_nodes();
+        auto rhs_root = other.release_nodes();
+        std::atomic<std::size_t> shared {0};
+        auto result = operation({lhs_root, black_height(lhs_root)}, {rhs_root, black_height(rhs_root)}, thread_count, shared);
+        auto size = lhs_size == base::unknown_size || rhs_size == base::unknown_size
+          ? base::known_size(result.root) : result_size(lhs_size, rhs_size, shared.load());
+        this->reset_root(result.root, size);
+      }
 
-      template <typename ArgType>
-      void insert(ArgType&& key)
+    protected:
+      // restores red black properties after red node was linked, returns true if black height of the tree has grown
+      bool fix_after_insert(node_t* current)
       {
-        auto current = this->preinsert(std::forward<ArgType>(key));
         while (true)
         {
           auto parent = current->parent();
           if (!parent)
           {
-            current->paint(color_t::black);
-            break;
+            recolor(current, color_t::black);
+            return true;
           }
 
-          if (parent->m_color == color_t::black)
-            break;
+          if (parent->color() == color_t::black)
+            return false;
 
           auto grand_parent = parent->parent();
           auto uncle = current->uncle();
-          if (uncle && uncle->m_color == color_t::red)
+          if (uncle && uncle->color() == color_t::red)
           {
-            parent->paint(color_t::black);
-            uncle->paint(color_t::black);
-            grand_parent->paint(color_t::red);
+            recolor(parent, color_t::black);
+            recolor(uncle, color_t::black);
+            recolor(grand_parent, color_t::red);
             current = grand_parent;
             continue;
           }
@@ -619,22 +2474,18 @@ namespace btree
           }
 
           this->rotate(grand_parent, other_direction(current->direction_from_parent()));
-          std::swap(grand_parent->m_color, parent->m_color);
-          break;
+          swap_colors(grand_parent, parent);
+          return false;
         }
       }
 
-      template <typename ArgType>
-      std::size_t erase(const ArgType& key)
+      // unlinks node with at most one child keeping red black properties, node isn't destroyed
+      void unlink(node_t* m)
       {
-        auto m = this->preerase(key);
-        if (!m)
-          return 0;
-
         if (m->color() == color_t::red)
           {
             this->replace_with_child(m);
-            return 1;
+            return;
           }
         auto c = m->single_child();
         auto p = m->parent();
@@ -643,19 +2494,19 @@ namespace btree
         this->replace_with_child(m);
         if (c && c->color() == color_t::red)
         {
-          c->paint(color_t::black);
-          return 1;
+          recolor(c, color_t::black);
+          return;
         }
 
         auto n = c;
         while (true)
         {
           if (p == nullptr)
-            return 1;
+            return;
 
           if (s->color() == color_t::red)
           {
-            std::swap(p->m_color, s->m_color);
+            swap_colors(p, s);
             this->rotate(p, n_direction);
             s = p->child(other_direction(n_direction)); // update sibling
           }
@@ -665,7 +2516,7 @@ namespace btree
           {
             if (p->color() == color_t::black)
             {
-              s->paint(color_t::red);
+              recolor(s, color_t::red);
               n = p;
               p = n->parent();
               s = n->sibling();
@@ -673,22 +2524,61 @@ namespace btree
               continue;
             }
 
-            std::swap(s->m_color, p->m_color);
+            swap_colors(s, p);
             break;
           }
           if (s->child_color(n_direction) == color_t::red)
           {
             this->rotate(s, other_direction(n_direction));
-            std::swap(s->m_color, s->parent()->m_color);
+            swap_colors(s, s->parent());
             s = s->parent();
           }
 
           this->rotate(p, n_direction);
-          std::swap(p->m_color, s->m_color);
-          s->child(other_direction(n_direction))->paint(color_t::black);
+          swap_colors(p, s);
+          recolor(s->child(other_direction(n_direction)), color_t::black);
           break;
         }
-        return 1;
+        return;
+      }
+
+      // color changes of rebalancing are reported to plugins
+      void recolor(node_t* node, color_t color)
+      {
+        if (node->color() == color)
+          return;
+        node->paint(color);
+        this->notify(tree_event::recoloring);
+      }
+
+      void swap_colors(node_t* lhs, node_t* rhs)
+      {
+        auto lhs_color = lhs->color();
+        recolor(lhs, rhs->color());
+        recolor(rhs, lhs_color);
+      }
+
+    private:
+      template <typename ForwardIt>
+      bool load_sorted(ForwardIt first, ForwardIt last)
+      {
+        if (std::adjacent_find(first, last, [](const KeyType& lhs, const KeyType& rhs) { return rhs < lhs; }) != last)
+          return false;
+        assign_sorted(first, last);
+        return true;
+      }
+
+      // subtrees sizes of built tree differ at most by one, so only the last level may be incomplete,
+      // painting it red keeps black height equal for all paths
+      static auto painter(std::size_t count)
+      {
+        int full_depth = 0;
+        while ((std::size_t{2} << full_depth) - 1 <= count)
+          ++full_depth;
+        return [full_depth](node_t* node, int depth)
+        {
+          node->paint(depth == full_depth ? color_t::red : color_t::black);
+        };
       }
     };
   };
@@ -697,4 +2587,8 @@ namespace btree
   using rb_tree = typename rb_tree_container<KeyType>::tree_t;
   template <typename KeyType>
   using indexed_rb_tree = typename rb_tree_container<KeyType, indexation_plugin>::tree_t;
+  template <typename KeyType>
+  using pooled_rb_tree = typename rb_tree_container<KeyType, pooled_allocation>::tree_t;
+  template <typename KeyType>
+  using pooled_indexed_rb_tree = typename rb_tree_container<KeyType, pooled_allocation, indexation_plugin>::tree_t;
 } // namespace btrees
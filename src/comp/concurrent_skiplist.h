@@ -0,0 +1,347 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace btree
+{
+  // Ordered set of unique keys for concurrent use (lazy skiplist). Lookups and iteration take no locks.
+  // insert and erase lock only the predecessors of the affected node and validate them once locked.
+  // Erased nodes are unlinked right away but freed only by reclaim() or with the set, so readers never touch
+  // freed memory. Without reclaim() memory grows with the number of erasures over the life of the set,
+  // so long-lived sets with churn have to call it periodically at a quiescent point.
+  // Iteration is weakly consistent: it sees every key present during the whole traversal.
+  template <typename KeyType>
+  class concurrent_skiplist
+  {
+    static constexpr int max_level = 32;
+
+    class node_t
+    {
+    public:
+      template <typename... ArgTypes>
+      static node_t* create(int top_level, ArgTypes&&... args)
+      {
+        auto memory = ::operator new(sizeof(node_t) + top_level * sizeof(link_t));
+        auto node = new (memory) node_t(top_level);
+        for (int level = 0; level < top_level; ++level)
+          new (&node->next(level)) link_t(nullptr);
+        if constexpr (sizeof...(ArgTypes) > 0)
+        {
+          try
+          {
+            new (node->m_key_storage) KeyType(std::forward<ArgTypes>(args)...);
+          }
+          catch (...)
+          {
+            ::operator delete(memory);
+            throw;
+          }
+        }
+        return node;
+      }
+
+      // the head carries no key
+      static void destroy(node_t* node, bool has_key)
+      {
+        if (has_key)
+          node->key().~KeyType();
+        node->~node_t();
+        ::operator delete(node);
+      }
+
+      const KeyType& key() const { return *std::launder(reinterpret_cast<const KeyType *>(m_key_storage)); }
+
+      std::atomic<node_t*>& next(int level)
+      {
+        return reinterpret_cast<link_t *>(this + 1)[level];
+      }
+
+      bool is_live() const { return m_fully_linked.load() && !m_marked.load(); }
+
+    private:
+      using link_t = std::atomic<node_t*>;
+      explicit node_t(int top_level) : m_top_level(top_level) {}
+
+      alignas(KeyType) unsigned char m_key_storage[sizeof(KeyType)];
+      std::mutex m_mutex;
+      std::atomic<bool> m_marked {false};
+      std::atomic<bool> m_fully_linked {false};
+      int m_top_level;
+
+      friend class concurrent_skiplist;
+    };
+
+  public:
+    class iterator_t
+    {
+      using self = iterator_t;
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using reference = const KeyType &;
+      using pointer = const KeyType *;
+      using value_type = const KeyType;
+      using difference_type = std::ptrdiff_t;
+
+      reference operator*() const { return m_node->key(); }
+      pointer operator->() const { return &m_node->key(); }
+
+      self& operator++()
+      {
+        m_node = m_node->next(0).load(std::memory_order_acquire);
+        skip_dead();
+        return *this;
+      }
+
+      bool operator==(const self& other) const { return m_node == other.m_node; }
+      bool operator!=(const self& other) const { return m_node != other.m_node; }
+
+    private:
+      explicit iterator_t(node_t* node) : m_node(node)
+      {
+        skip_dead();
+      }
+
+      void skip_dead()
+      {
+        while (m_node && !m_node->is_live())
+          m_node = m_node->next(0).load(std::memory_order_acquire);
+      }
+
+      node_t* m_node;
+
+      friend class concurrent_skiplist;
+    };
+
+    using iterator = iterator_t;
+
+    concurrent_skiplist() : m_head(node_t::create(max_level)) {}
+    concurrent_skiplist(const concurrent_skiplist&) = delete;
+    concurrent_skiplist& operator=(const concurrent_skiplist&) = delete;
+
+    ~concurrent_skiplist()
+    {
+      for (auto node = m_head->next(0).load(); node;)
+      {
+        auto next = node->next(0).load();
+        node_t::destroy(node, true);
+        node = next;
+      }
+      for (auto node : m_retired)
+        node_t::destroy(node, true);
+      node_t::destroy(m_head, false);
+    }
+
+    // false if the key is already present
+    bool insert(KeyType key)
+    {
+      auto top_level = random_level();
+      node_t* preds[max_level];
+      node_t* succs[max_level];
+      while (true)
+      {
+        auto found = find_position(key, preds, succs);
+        if (found != -1)
+        {
+          auto node = succs[found];
+          if (node->m_marked.load())
+            continue;
+          while (!node->m_fully_linked.load())
+            std::this_thread::yield();
+          return false;
+        }
+
+        std::array<std::unique_lock<std::mutex>, max_level> locks;
+        auto valid = lock_predecessors(preds, top_level, locks, [&](int level)
+        {
+          return (!succs[level] || !succs[level]->m_marked.load()) && preds[level]->next(level).load() == succs[level];
+        });
+        if (!valid)
+          continue;
+
+        auto node = node_t::create(top_level, std::move(key));
+        for (int level = 0; level < top_level; ++level)
+          node->next(level).store(succs[level], std::memory_order_relaxed);
+        for (int level = 0; level < top_level; ++level)
+          preds[level]->next(level).store(node, std::memory_order_release);
+        node->m_fully_linked.store(true);
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    template <typename ArgType>
+    bool erase(const ArgType& key)
+    {
+      node_t* preds[max_level];
+      node_t* succs[max_level];
+      node_t* victim = nullptr;
+      std::unique_lock<std::mutex> victim_lock;
+      while (true)
+      {
+        auto found = find_position(key, preds, succs);
+        if (!victim)
+        {
+          // a node which is still being linked hasn't been inserted yet
+          if (found == -1 || !succs[found]->m_fully_linked.load() || succs[found]->m_top_level - 1 != found)
+            return false;
+          victim = succs[found];
+          victim_lock = std::unique_lock<std::mutex>(victim->m_mutex);
+          if (victim->m_marked.load())
+            return false;
+          victim->m_marked.store(true);
+        }
+
+        std::array<std::unique_lock<std::mutex>, max_level> locks;
+        auto valid = lock_predecessors(preds, victim->m_top_level, locks, [&](int level)
+        {
+          return preds[level]->next(level).load() == victim;
+        });
+        if (!valid)
+          continue;
+
+        for (int level = victim->m_top_level - 1; level >= 0; --level)
+          preds[level]->next(level).store(victim->next(level).load(std::memory_order_relaxed), std::memory_order_release);
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        victim_lock.unlock();
+        retire(victim);
+        return true;
+      }
+    }
+
+    template <typename ArgType>
+    iterator_t find(const ArgType& key) const
+    {
+      auto node = lower_bound_node(key);
+      if (!node || key < node->key() || !node->is_live())
+        return end();
+      return iterator_t(node);
+    }
+
+    template <typename ArgType>
+    bool contains(const ArgType& key) const
+    {
+      return find(key) != end();
+    }
+
+    template <typename ArgType>
+    iterator_t lower_bound(const ArgType& key) const
+    {
+      return iterator_t(lower_bound_node(key));
+    }
+
+    iterator_t begin() const { return iterator_t(m_head->next(0).load(std::memory_order_acquire)); }
+    iterator_t end() const { return iterator_t(nullptr); }
+
+    // exact only while nobody modifies the set
+    std::size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+    // frees erased nodes and returns their number; no other thread may use the set meanwhile
+    // and iterators obtained before are invalidated
+    std::size_t reclaim()
+    {
+      std::vector<node_t*> retired;
+      {
+        std::lock_guard<std::mutex> guard(m_retired_mutex);
+        retired.swap(m_retired);
+      }
+      for (auto node : retired)
+        node_t::destroy(node, true);
+      return retired.size();
+    }
+
+    // number of erased nodes waiting for reclaim()
+    std::size_t retired_count() const
+    {
+      std::lock_guard<std::mutex> guard(m_retired_mutex);
+      return m_retired.size();
+    }
+
+  private:
+    static int random_level()
+    {
+      thread_local std::minstd_rand generator(static_cast<unsigned>(std::hash<std::thread::id>{}(std::this_thread::get_id())));
+      int level = 1;
+      for (auto bits = generator(); level < max_level && (bits & 1); bits >>= 1)
+        ++level;
+      return level;
+    }
+
+    // fills predecessors and successors of key on every level, returns the highest level where key was found
+    template <typename ArgType>
+    int find_position(const ArgType& key, node_t** preds, node_t** succs) const
+    {
+      int found = -1;
+      auto pred = m_head;
+      for (int level = max_level - 1; level >= 0; --level)
+      {
+        auto current = pred->next(level).load(std::memory_order_acquire);
+        while (current && current->key() < key)
+        {
+          pred = current;
+          current = pred->next(level).load(std::memory_order_acquire);
+        }
+        if (found == -1 && current && !(key < current->key()))
+          found = level;
+        preds[level] = pred;
+        succs[level] = current;
+      }
+      return found;
+    }
+
+    template <typename ArgType>
+    node_t* lower_bound_node(const ArgType& key) const
+    {
+      auto pred = m_head;
+      node_t* current = nullptr;
+      for (int level = max_level - 1; level >= 0; --level)
+      {
+        current = pred->next(level).load(std::memory_order_acquire);
+        while (current && current->key() < key)
+        {
+          pred = current;
+          current = pred->next(level).load(std::memory_order_acquire);
+        }
+      }
+      return current;
+    }
+
+    // locks distinct predecessors bottom-up, which is descending key order for every thread
+    template <typename Validate>
+    static bool lock_predecessors(node_t** preds, int count, std::array<std::unique_lock<std::mutex>, max_level>& locks, Validate validate)
+    {
+      node_t* previous = nullptr;
+      for (int level = 0; level < count; ++level)
+      {
+        auto pred = preds[level];
+        if (pred != previous)
+        {
+          locks[level] = std::unique_lock<std::mutex>(pred->m_mutex);
+          previous = pred;
+        }
+        if (pred->m_marked.load() || !validate(level))
+          return false;
+      }
+      return true;
+    }
+
+    void retire(node_t* node)
+    {
+      std::lock_guard<std::mutex> guard(m_retired_mutex);
+      m_retired.push_back(node);
+    }
+
+  private:
+    node_t* m_head;
+    std::atomic<std::size_t> m_size {0};
+    mutable std::mutex m_retired_mutex;
+    std::vector<node_t*> m_retired;
+  };
+} // namespace btree
@@ -0,0 +1,320 @@
+#pragma once
+#include "comp/btree.h"
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace btree
+{
+  // Red black tree with immutable nodes shared between versions. Every update rebuilds only the path
+  // to the changed key through joins, so a snapshot is taken in O(1) and stays valid forever.
+  // One thread may update the tree while any number of threads take snapshots and read them.
+  // Taking a snapshot isn't lock-free: std::atomic_load of shared_ptr guards the root with a lock inside
+  // the standard library (a small spinlock pool in libstdc++), held only while the pointer is copied.
+  // Reading a snapshot takes no locks, apart from reference count updates of the nodes on its path.
+  template <typename KeyType>
+  class persistent_rb_tree
+  {
+  public:
+    class node_t;
+    class iterator_t;
+    class snapshot_t;
+    using node_ptr = std::shared_ptr<const node_t>;
+
+    class node_t
+    {
+    public:
+      node_t(node_ptr left_child, KeyType key, node_ptr right_child, color_t color)
+        : m_key(std::move(key)), m_children{{std::move(left_child), std::move(right_child)}}, m_color(color)
+      {
+        m_node_count = 1 + (m_children[left] ? m_children[left]->m_node_count : 0)
+                         + (m_children[right] ? m_children[right]->m_node_count : 0);
+        m_black_height = (m_children[left] ? m_children[left]->m_black_height : 0) + (color == color_t::black);
+      }
+
+      const KeyType& key() const { return m_key; }
+      const node_t* child(direction_t direction) const { return m_children[direction].get(); }
+      color_t color() const { return m_color; }
+      std::size_t node_count() const { return m_node_count; }
+
+    private:
+      KeyType m_key;
+      std::array<node_ptr, 2> m_children;
+      std::size_t m_node_count;
+      int m_black_height;
+      color_t m_color;
+
+      friend class persistent_rb_tree;
+    };
+
+    // keeps the path from the root, the snapshot has to outlive the iterator
+    class iterator_t
+    {
+      using self = iterator_t;
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using reference = const KeyType &;
+      using pointer = const KeyType *;
+      using value_type = const KeyType;
+      using difference_type = std::ptrdiff_t;
+
+      iterator_t() = default;
+
+      reference operator*() const { return m_path.back()->key(); }
+      pointer operator->() const { return &m_path.back()->key(); }
+
+      self& operator++()
+      {
+        auto node = m_path.back();
+        m_path.pop_back();
+        push_leftmost(node->child(right));
+        return *this;
+      }
+
+      bool operator==(const self& other) const
+      {
+        if (m_path.empty() || other.m_path.empty())
+          return m_path.empty() == other.m_path.empty();
+        return m_path.back() == other.m_path.back();
+      }
+
+      bool operator!=(const self& other) const
+      {
+        return !(*this == other);
+      }
+
+    private:
+      void push_leftmost(const node_t* node)
+      {
+        for (; node; node = node->child(left))
+          m_path.push_back(node);
+      }
+
+      // nodes whose left subtree is being visited, the current one is on top
+      std::vector<const node_t*> m_path;
+
+      friend class snapshot_t;
+    };
+
+    // immutable version of the tree
+    class snapshot_t
+    {
+    public:
+      using iterator = iterator_t;
+
+      snapshot_t() = default;
+
+      std::size_t size() const { return m_root ? m_root->node_count() : 0; }
+      bool empty() const { return !m_root; }
+      const node_t* root() const { return m_root.get(); }
+
+      iterator_t begin() const
+      {
+        iterator_t result;
+        result.push_leftmost(m_root.get());
+        return result;
+      }
+
+      iterator_t end() const
+      {
+        return {};
+      }
+
+      template <typename ArgType>
+      iterator_t lower_bound(const ArgType& key) const
+      {
+        iterator_t result;
+        for (auto current = m_root.get(); current;)
+        {
+          if (current->key() < key)
+            current = current->child(right);
+          else
+          {
+            result.m_path.push_back(current);
+            current = current->child(left);
+          }
+        }
+        return result;
+      }
+
+      template <typename ArgType>
+      iterator_t find(const ArgType& key) const
+      {
+        auto result = lower_bound(key);
+        if (result != end() && key < *result)
+          return end();
+        return result;
+      }
+
+      template <typename ArgType>
+      bool contains(const ArgType& key) const
+      {
+        return find(key) != end();
+      }
+
+    private:
+      explicit snapshot_t(node_ptr root) : m_root(std::move(root)) {}
+
+      node_ptr m_root;
+
+      friend class persistent_rb_tree;
+    };
+
+  public:
+    persistent_rb_tree() = default;
+
+    // safe to call from any thread while the owner updates the tree
+    snapshot_t snapshot() const
+    {
+      return snapshot_t(std::atomic_load(&m_root));
+    }
+
+    std::size_t size() const { return m_root ? m_root->node_count() : 0; }
+
+    void insert(KeyType key)
+    {
+      publish(insert_into(m_root, std::move(key)));
+    }
+
+    template <typename ArgType>
+    std::size_t erase(const ArgType& key)
+    {
+      bool erased = false;
+      auto root = erase_from(m_root, key, erased);
+      if (!erased)
+        return 0;
+
+      publish(std::move(root));
+      return 1;
+    }
+
+    void clear()
+    {
+      publish(nullptr);
+    }
+
+  private:
+    void publish(node_ptr root)
+    {
+      std::atomic_store(&m_root, repaint(root, color_t::black));
+    }
+
+    static node_ptr make_node(node_ptr left_child, KeyType key, node_ptr right_child, color_t color)
+    {
+      return std::make_shared<const node_t>(std::move(left_child), std::move(key), std::move(right_child), color);
+    }
+
+    // node with child on the given side and other_child on the opposite one
+    static node_ptr make_node_towards(direction_t direction, node_ptr other_child, KeyType key, node_ptr child, color_t color)
+    {
+      if (direction == right)
+        return make_node(std::move(other_child), std::move(key), std::move(child), color);
+      return make_node(std::move(child), std::move(key), std::move(other_child), color);
+    }
+
+    static node_ptr repaint(const node_ptr& node, color_t color)
+    {
+      if (!node || node->color() == color)
+        return node;
+      return make_node(node->m_children[left], node->key(), node->m_children[right], color);
+    }
+
+    static color_t color_of(const node_t* node) { return node ? node->color() : color_t::black; }
+    static int black_height(const node_t* node) { return node ? node->m_black_height : 0; }
+
+    // joins valid red black trees with keys of lhs not greater than key and keys of rhs not less than it,
+    // in O(difference of black heights), the root of the result may be red
+    static node_ptr join(node_ptr lhs, KeyType key, node_ptr rhs)
+    {
+      lhs = repaint(lhs, color_t::black);
+      rhs = repaint(rhs, color_t::black);
+      auto lhs_height = black_height(lhs.get());
+      auto rhs_height = black_height(rhs.get());
+      if (lhs_height == rhs_height)
+        return make_node(std::move(lhs), std::move(key), std::move(rhs), color_t::red);
+
+      auto direction = lhs_height > rhs_height ? right : left;
+      auto joined = direction == right ? join_spine(lhs, std::move(key), rhs, right) : join_spine(rhs, std::move(key), lhs, left);
+      if (joined->color() == color_t::red && color_of(joined->child(direction)) == color_t::red)
+        joined = repaint(joined, color_t::black);
+      return joined;
+    }
+
+    // descends the spine of taller tree in direction until black heights match, copying the nodes on the way,
+    // a red violation is left for the caller only when taller tree has red root
+    static node_ptr join_spine(const node_ptr& taller, KeyType key, const node_ptr& shorter, direction_t direction)
+    {
+      if (color_of(taller.get()) == color_t::black && black_height(taller.get()) == black_height(shorter.get()))
+        return make_node_towards(direction, taller, std::move(key), shorter, color_t::red);
+
+      auto inner = join_spine(taller->m_children[direction], std::move(key), shorter, direction);
+      auto& other_child = taller->m_children[other_direction(direction)];
+      if (taller->color() == color_t::black && inner->color() == color_t::red && color_of(inner->child(direction)) == color_t::red)
+      {
+        auto lowered = make_node_towards(direction, other_child, taller->key(), inner->m_children[other_direction(direction)], color_t::black);
+        return make_node_towards(direction, std::move(lowered), inner->key(), repaint(inner->m_children[direction], color_t::black), color_t::red);
+      }
+      return make_node_towards(direction, other_child, taller->key(), std::move(inner), taller->color());
+    }
+
+    // joins trees with all keys of lhs not greater than keys of rhs
+    static node_ptr join(node_ptr lhs, node_ptr rhs)
+    {
+      if (!lhs)
+        return rhs;
+      if (!rhs)
+        return lhs;
+
+      auto last = take_last(lhs);
+      return join(std::move(last.first), std::move(last.second), std::move(rhs));
+    }
+
+    // tree without its greatest key and that key
+    static std::pair<node_ptr, KeyType> take_last(const node_ptr& node)
+    {
+      if (!node->child(right))
+        return {node->m_children[left], node->key()};
+
+      auto last = take_last(node->m_children[right]);
+      return {join(node->m_children[left], node->key(), std::move(last.first)), std::move(last.second)};
+    }
+
+    static node_ptr insert_into(const node_ptr& node, KeyType key)
+    {
+      if (!node)
+        return make_node(nullptr, std::move(key), nullptr, color_t::red);
+
+      if (key < node->key())
+        return join(insert_into(node->m_children[left], std::move(key)), node->key(), node->m_children[right]);
+      return join(node->m_children[left], node->key(), insert_into(node->m_children[right], std::move(key)));
+    }
+
+    // returns node itself if there is no such key
+    template <typename ArgType>
+    static node_ptr erase_from(const node_ptr& node, const ArgType& key, bool& erased)
+    {
+      if (!node)
+        return node;
+
+      for (auto direction : {left, right})
+        if (direction == left ? key < node->key() : node->key() < key)
+        {
+          auto changed = erase_from(node->m_children[direction], key, erased);
+          if (!erased)
+            return node;
+          auto& other_child = node->m_children[other_direction(direction)];
+          return direction == left ? join(std::move(changed), node->key(), other_child) : join(other_child, node->key(), std::move(changed));
+        }
+
+      erased = true;
+      return join(node->m_children[left], node->m_children[right]);
+    }
+
+  private:
+    // replaced only through std::atomic_store by the updating thread
+    node_ptr m_root;
+  };
+} // namespace btree
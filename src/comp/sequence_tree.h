@@ -0,0 +1,147 @@
+#pragma once
+#include "comp/btree.h"
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace btree
+{
+  // Sequence with positional access, insertion, erasure, splitting and concatenation in O(log n).
+  // Values are ordered by position only and never compared; positions come from node counts of a red black tree.
+  template <typename ValueType, template <typename> class... Plugins>
+  class sequence_tree : protected rb_tree_container<ValueType, indexation_plugin, Plugins...>::tree_t
+  {
+    using base = typename rb_tree_container<ValueType, indexation_plugin, Plugins...>::tree_t;
+    using node_t = typename base::node_t;
+    using subtree_t = typename base::subtree_t;
+    static_assert (std::decay_t<decltype(std::declval<base&>().node_allocator())>::transferable_nodes,
+                   "nodes of pooled tree can't be moved to another tree");
+  public:
+    using iterator = typename base::iterator;
+    using base::begin;
+    using base::end;
+    using base::size;
+    using base::clear;
+    using base::root;
+
+    sequence_tree() = default;
+
+    template <typename ForwardIt>
+    sequence_tree(ForwardIt first, ForwardIt last)
+    {
+      this->assign_sorted(first, last);
+    }
+
+    const ValueType& at(std::size_t index) const
+    {
+      assert (index < size());
+      return node_at(root(), index)->key();
+    }
+
+    // inserts value before position index, index equal to size() appends it
+    template <typename ArgType>
+    iterator insert_at(std::size_t index, ArgType&& value)
+    {
+      assert (index <= size());
+      auto node = this->create_node(std::forward<ArgType>(value));
+      if (index == size())
+        this->attach(this->furthest_node(right), right, node);
+      else
+      {
+        auto next = node_at(root(), index);
+        if (auto child = next->child(left))
+          this->attach(child->furthest_node(right), right, node);
+        else
+          this->attach(next, left, node);
+      }
+      this->fix_after_insert(node);
+      return {node};
+    }
+
+    // returns iterator to the value which followed the erased one
+    iterator erase_at(std::size_t index)
+    {
+      assert (index < size());
+      return base::erase(iterator(node_at(root(), index)));
+    }
+
+    // appends all values of other, leaving it empty
+    void concat(sequence_tree& other)
+    {
+      base::join(other);
+    }
+
+    // moves values from position index on to right_tree, its previous content is dropped
+    void split_at(std::size_t index, sequence_tree& right_tree)
+    {
+      assert (index <= size());
+      right_tree.clear();
+      auto root = this->release_nodes();
+      if (!root)
+        return;
+
+      auto parts = split_subtree_at(root, base::black_height(root), index);
+      this->reset_root(parts.first.root, base::known_size(parts.first.root));
+      right_tree.reset_root(parts.second.root, base::known_size(parts.second.root));
+    }
+
+    // moves all values of other before position index
+    void splice(std::size_t index, sequence_tree& other)
+    {
+      sequence_tree tail;
+      split_at(index, tail);
+      concat(other);
+      concat(tail);
+    }
+
+    // moves values of other at positions [first, last) before position index
+    void splice(std::size_t index, sequence_tree& other, std::size_t first, std::size_t last)
+    {
+      assert (first <= last && last <= other.size());
+      sequence_tree middle, tail;
+      other.split_at(last, tail);
+      other.split_at(first, middle);
+      other.concat(tail);
+      splice(index, middle);
+    }
+
+  private:
+    template <typename NodePointer>
+    static NodePointer node_at(NodePointer current, std::size_t index)
+    {
+      while (true)
+      {
+        auto left_count = current->child(left) ? current->child(left)->node_count() : 0;
+        if (index == left_count)
+          return current;
+        if (index < left_count)
+          current = current->child(left);
+        else
+        {
+          index -= left_count + 1;
+          current = current->child(right);
+        }
+      }
+    }
+
+    // splits detached subtree with black root into its first index values and the rest
+    static std::pair<subtree_t, subtree_t> split_subtree_at(node_t* root, int height, std::size_t index)
+    {
+      if (!root)
+        return {{nullptr, 0}, {nullptr, 0}};
+
+      auto left_count = root->child(left) ? root->child(left)->node_count() : 0;
+      auto lhs = base::take_out_child(root, height, left);
+      auto rhs = base::take_out_child(root, height, right);
+      if (left_count < index)
+      {
+        auto parts = split_subtree_at(rhs.root, rhs.black_height, index - left_count - 1);
+        return {base::join_subtrees(lhs, root, parts.first), parts.second};
+      }
+
+      auto parts = split_subtree_at(lhs.root, lhs.black_height, index);
+      return {parts.first, base::join_subtrees(parts.second, root, rhs)};
+    }
+  };
+} // namespace btree
@@ -0,0 +1,170 @@
+#pragma once
+#include "comp/btree.h"
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+namespace btree
+{
+  // self-adjusting tree on the same core as rb_tree_container, every insertion, lookup through find()
+  // and erasure moves the node it reached to the root, so operations take amortized O(log n)
+  // and recently or frequently used keys are found close to the root
+  template <typename KeyType, template<typename> class... Plugins>
+  struct splay_tree_container
+  {
+    class tree_t;
+
+    struct node_t : btree_container<KeyType, node_t, Plugins...>::node_t
+    {
+      using parent_t = typename btree_container<KeyType, node_t, Plugins...>::node_t;
+      using parent_t::parent_t;
+    };
+
+    class tree_t : public btree_container<KeyType, typename splay_tree_container::node_t, Plugins...>::tree_t
+    {
+      using self = tree_t;
+      using base = typename btree_container<KeyType, typename splay_tree_container::node_t, Plugins...>::tree_t;
+    public:
+      using node_t = typename splay_tree_container::node_t;
+
+      tree_t () : base () {}
+      ~tree_t () {}
+
+      tree_t (const tree_t &) = default;
+      tree_t &operator= (const tree_t &) = default;
+      tree_t (tree_t &&) noexcept = default;
+      tree_t &operator= (tree_t &&) noexcept = default;
+
+      friend void swap (tree_t &lhs, tree_t &rhs) noexcept { lhs.swap (rhs); }
+
+      // [first, last) has to be sorted, builds the tree in O(n)
+      template <typename ForwardIt>
+      void assign_sorted(ForwardIt first, ForwardIt last)
+      {
+        this->build_sorted(first, last, [](node_t*, int) {});
+      }
+
+      template <typename ArgType>
+      void insert(ArgType&& key)
+      {
+        splay(this->preinsert(std::forward<ArgType>(key)));
+      }
+
+      // inserts key as close as possible before hint, in O(1) if it belongs right there
+      template <typename ArgType>
+      typename base::iterator insert(typename base::iterator hint, ArgType&& key)
+      {
+        auto node = this->preinsert(hint, std::forward<ArgType>(key));
+        splay(node);
+        return {node};
+      }
+
+      // constructs the key in a new node from args
+      template <typename... ArgTypes>
+      typename base::iterator emplace(ArgTypes&&... args)
+      {
+        auto node = this->link_node(this->create_node(std::forward<ArgTypes>(args)...));
+        splay(node);
+        return {node};
+      }
+
+      // splays the found node, or the last one visited if there is no such key
+      template <typename ArgType>
+      typename base::iterator find(const ArgType& key)
+      {
+        this->notify(tree_event::lookup);
+        node_t* last = nullptr;
+        node_t* found = nullptr;
+        for (auto current = this->root(); current;)
+        {
+          last = current;
+          if (this->key_less(current->key(), key))
+            current = current->child(right);
+          else if (this->key_less(key, current->key()))
+            current = current->child(left);
+          else
+          {
+            found = current;
+            break;
+          }
+        }
+        if (last)
+          splay(last);
+        return found ? typename base::iterator(found) : this->end();
+      }
+
+      template <typename ArgType>
+      bool contains(const ArgType& key)
+      {
+        return find(key) != this->end();
+      }
+
+      template <typename ArgType>
+      std::size_t erase(const ArgType& key)
+      {
+        auto node = this->preerase(key);
+        if (!node)
+          return 0;
+
+        unlink(node);
+        this->destroy_node(node);
+        return 1;
+      }
+
+      // returns iterator following the erased key, iterators to other keys stay valid
+      typename base::iterator erase(typename base::iterator position)
+      {
+        auto next = position;
+        ++next;
+        auto node = this->preerase_node(base::node_of(position));
+        unlink(node);
+        this->destroy_node(node);
+        return next;
+      }
+
+      typename base::iterator erase(typename base::iterator first, typename base::iterator last)
+      {
+        while (first != last)
+          first = erase(first);
+        return last;
+      }
+
+    private:
+      // moves node to the root by zig-zig and zig-zag steps, which roughly halve depths along the path
+      void splay(node_t* node)
+      {
+        while (auto parent = node->parent())
+        {
+          auto direction = node->direction_from_parent();
+          auto grand_parent = parent->parent();
+          if (!grand_parent)
+            this->rotate(parent, other_direction(direction));
+          else if (parent->direction_from_parent() == direction)
+          {
+            this->rotate(grand_parent, other_direction(direction));
+            this->rotate(parent, other_direction(direction));
+          }
+          else
+          {
+            this->rotate(parent, other_direction(direction));
+            this->rotate(grand_parent, direction);
+          }
+        }
+      }
+
+      // unlinks node with at most one child and splays its parent, node isn't destroyed
+      void unlink(node_t* node)
+      {
+        auto parent = node->parent();
+        this->replace_with_child(node);
+        if (parent)
+          splay(parent);
+      }
+    };
+  };
+
+  template <typename KeyType>
+  using splay_tree = typename splay_tree_container<KeyType>::tree_t;
+  template <typename KeyType>
+  using indexed_splay_tree = typename splay_tree_container<KeyType, indexation_plugin>::tree_t;
+} // namespace btree
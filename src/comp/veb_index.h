@@ -0,0 +1,245 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace btree
+{
+  namespace detail
+  {
+    // positions of nodes of a perfect binary tree laid out in van Emde Boas order: the tree is cut in the middle level,
+    // the top half is stored first and every bottom subtree follows it contiguously, recursively.
+    // For every depth the tables keep the cut which made it a root of bottom trees (Brodal, Fagerberg, Jacob).
+    class veb_layout
+    {
+    public:
+      static constexpr int max_height = 64;
+
+      explicit veb_layout(int height = 0) : m_height(height)
+      {
+        cut(0, height);
+      }
+
+      int height() const { return m_height; }
+      std::size_t slot_count() const { return m_height ? (std::size_t(2) << (m_height - 1)) - 1 : 0; }
+
+      // position of the node at depth with 1-based BFS index bfs, path holds positions of its ancestors by depth
+      std::size_t position(const std::size_t* path, int depth, std::size_t bfs) const
+      {
+        if (depth == 0)
+          return 0;
+        return path[m_top_depth[depth]] + m_top_size[depth] + (bfs & m_top_size[depth]) * m_bottom_size[depth];
+      }
+
+      std::size_t rank(int depth, std::size_t bfs) const
+      {
+        auto offset = bfs - (std::size_t(1) << depth);
+        return ((2 * offset + 1) << (m_height - 1 - depth)) - 1;
+      }
+
+    private:
+      void cut(int depth, int height)
+      {
+        if (height <= 1)
+          return;
+        auto top = height / 2;
+        auto bottom = height - top;
+        m_top_size[depth + top] = (std::size_t(1) << top) - 1;
+        m_bottom_size[depth + top] = (std::size_t(1) << bottom) - 1;
+        m_top_depth[depth + top] = depth;
+        cut(depth, top);
+        cut(depth + top, bottom);
+      }
+
+    private:
+      int m_height;
+      std::array<std::size_t, max_height> m_top_size {};
+      std::array<std::size_t, max_height> m_bottom_size {};
+      std::array<int, max_height> m_top_depth {};
+    };
+
+    struct veb_file_header
+    {
+      char magic[8];
+      std::uint64_t count;
+      std::uint32_t height;
+      std::uint32_t key_size;
+    };
+
+    constexpr char veb_magic[8] = {'b', 't', 'r', 'e', 'e', 'v', 'e', 'b'};
+  } // namespace detail
+
+  // Read-only search index over slots in van Emde Boas layout which it doesn't own, e.g. a memory mapped file.
+  // Sorted keys fill a perfect tree in order and the slots left over are padding treated as greater than any key,
+  // so a search touches O(log_B n) blocks for every block size B at once.
+  template <typename KeyType>
+  class veb_index_view
+  {
+    static_assert (std::is_trivially_copyable<KeyType>::value, "keys are stored as raw bytes");
+  public:
+    veb_index_view() = default;
+
+    veb_index_view(const KeyType* slots, std::size_t count, int height)
+      : m_slots(slots), m_count(count), m_layout(height)
+    {
+    }
+
+    std::size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+
+    // number of keys less than key
+    template <typename ArgType>
+    std::size_t lower_bound(const ArgType& key) const
+    {
+      return descend([&](const KeyType& slot_key) { return slot_key < key; }).first;
+    }
+
+    // number of keys not greater than key
+    template <typename ArgType>
+    std::size_t upper_bound(const ArgType& key) const
+    {
+      return descend([&](const KeyType& slot_key) { return !(key < slot_key); }).first;
+    }
+
+    template <typename ArgType>
+    bool contains(const ArgType& key) const
+    {
+      auto found = descend([&](const KeyType& slot_key) { return slot_key < key; });
+      return found.first < m_count && !(key < m_slots[found.second]);
+    }
+
+    // header followed by the slots, both in native byte order
+    void write(std::ostream& stream) const
+    {
+      detail::veb_file_header header {};
+      std::memcpy(header.magic, detail::veb_magic, sizeof(header.magic));
+      header.count = m_count;
+      header.height = static_cast<std::uint32_t>(m_layout.height());
+      header.key_size = sizeof(KeyType);
+      stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      stream.write(std::string(slots_offset - sizeof(header), '\0').data(), slots_offset - sizeof(header));
+      stream.write(reinterpret_cast<const char *>(m_slots), static_cast<std::streamsize>(m_layout.slot_count() * sizeof(KeyType)));
+    }
+
+    // view over data written by write(), nothing if it doesn't hold an index of KeyType
+    static std::optional<veb_index_view> from_memory(const void* data, std::size_t bytes)
+    {
+      detail::veb_file_header header;
+      if (bytes < slots_offset)
+        return std::nullopt;
+      std::memcpy(&header, data, sizeof(header));
+      if (std::memcmp(header.magic, detail::veb_magic, sizeof(header.magic)) != 0 || header.key_size != sizeof(KeyType)
+          || header.height >= detail::veb_layout::max_height)
+        return std::nullopt;
+
+      auto slots = static_cast<const char *>(data) + slots_offset;
+      veb_index_view view(reinterpret_cast<const KeyType *>(slots), static_cast<std::size_t>(header.count), static_cast<int>(header.height));
+      if (reinterpret_cast<std::uintptr_t>(slots) % alignof(KeyType) != 0 || view.m_count > view.m_layout.slot_count()
+          || (bytes - slots_offset) / sizeof(KeyType) < view.m_layout.slot_count())
+        return std::nullopt;
+      return view;
+    }
+
+  private:
+    static constexpr std::size_t slots_offset = (sizeof(detail::veb_file_header) + alignof(KeyType) - 1) / alignof(KeyType) * alignof(KeyType);
+
+    // rank and slot of the last node where the search turned left, the rank is m_count if there is none
+    template <typename GoesRight>
+    std::pair<std::size_t, std::size_t> descend(GoesRight goes_right) const
+    {
+      std::array<std::size_t, detail::veb_layout::max_height> path;
+      std::pair<std::size_t, std::size_t> found {m_count, 0};
+      std::size_t bfs = 1;
+      for (int depth = 0; depth < m_layout.height(); ++depth)
+      {
+        path[depth] = m_layout.position(path.data(), depth, bfs);
+        auto rank = m_layout.rank(depth, bfs);
+        bool right = rank < m_count && goes_right(m_slots[path[depth]]);
+        if (!right && rank < found.first)
+          found = {rank, path[depth]};
+        bfs = 2 * bfs + right;
+      }
+      return found;
+    }
+
+  private:
+    const KeyType* m_slots = nullptr;
+    std::size_t m_count = 0;
+    detail::veb_layout m_layout;
+  };
+
+  // owning in-memory van Emde Boas index, keys have to be default constructible for padding
+  template <typename KeyType>
+  class veb_index
+  {
+  public:
+    veb_index() = default;
+    veb_index(const veb_index&) = delete;
+    veb_index& operator=(const veb_index&) = delete;
+    veb_index(veb_index&&) = default;
+    veb_index& operator=(veb_index&&) = default;
+
+    // [first, last) has to be sorted
+    template <typename ForwardIt>
+    veb_index(ForwardIt first, ForwardIt last)
+    {
+      std::vector<KeyType> sorted(first, last);
+      int height = 0;
+      while (detail::veb_layout(height).slot_count() < sorted.size())
+        ++height;
+
+      detail::veb_layout layout(height);
+      m_slots.resize(layout.slot_count());
+      std::array<std::size_t, detail::veb_layout::max_height> path;
+      place(layout, sorted, path.data(), 0, 1);
+      m_view = veb_index_view<KeyType>(m_slots.data(), sorted.size(), height);
+    }
+
+    const veb_index_view<KeyType>& view() const { return m_view; }
+
+    std::size_t size() const { return m_view.size(); }
+
+    template <typename ArgType>
+    std::size_t lower_bound(const ArgType& key) const { return m_view.lower_bound(key); }
+
+    template <typename ArgType>
+    std::size_t upper_bound(const ArgType& key) const { return m_view.upper_bound(key); }
+
+    template <typename ArgType>
+    bool contains(const ArgType& key) const { return m_view.contains(key); }
+
+    void write(std::ostream& stream) const { m_view.write(stream); }
+
+  private:
+    void place(const detail::veb_layout& layout, const std::vector<KeyType>& sorted, std::size_t* path, int depth, std::size_t bfs)
+    {
+      if (depth == layout.height())
+        return;
+      path[depth] = layout.position(path, depth, bfs);
+      auto rank = layout.rank(depth, bfs);
+      if (rank < sorted.size())
+        m_slots[path[depth]] = sorted[rank];
+      place(layout, sorted, path, depth + 1, 2 * bfs);
+      place(layout, sorted, path, depth + 1, 2 * bfs + 1);
+    }
+
+  private:
+    std::vector<KeyType> m_slots;
+    veb_index_view<KeyType> m_view;
+  };
+
+  // snapshot of any ordered btree container
+  template <typename TreeType>
+  auto freeze_veb(TreeType& tree)
+  {
+    return veb_index<std::decay_t<decltype(*tree.begin())>>(tree.begin(), tree.end());
+  }
+} // namespace btree
@@ -0,0 +1,95 @@
+#include "comp/avl_tree.h"
+#include "catch.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace
+{
+  // checks order, balances and node counts, returns height
+  template <typename Node>
+  int check_avl_node (const Node *node)
+  {
+    using namespace btree;
+    if (!node)
+      return 0;
+
+    int heights[2];
+    for (auto direction : {left, right})
+      {
+        auto child = node->child (direction);
+        if (child)
+          REQUIRE (child->parent () == node);
+        if (child && direction == left)
+          REQUIRE (!(node->key () < child->key ()));
+        if (child && direction == right)
+          REQUIRE (!(child->key () < node->key ()));
+        heights[direction] = check_avl_node (child);
+      }
+    REQUIRE (std::abs (heights[left] - heights[right]) <= 1);
+    auto expected = heights[left] == heights[right] ? none : heights[left] > heights[right] ? left : right;
+    REQUIRE (node->heavy () == expected);
+    if constexpr (detail::has_node_count<Node>::value)
+      REQUIRE (node->node_count () == 1 + (node->child (left) ? node->child (left)->node_count () : 0)
+                                        + (node->child (right) ? node->child (right)->node_count () : 0));
+    return std::max (heights[left], heights[right]) + 1;
+  }
+}
+
+TEST_CASE("avl_tree")
+{
+  using namespace btree;
+  indexed_avl_tree<int> tree;
+  std::multiset<int> reference;
+  std::mt19937 gen (41);
+  for (int i = 0; i < 6000; ++i)
+    {
+      auto key = static_cast<int> (gen () % 700);
+      if (gen () % 3)
+        {
+          tree.insert (key);
+          reference.insert (key);
+        }
+      else
+        {
+          auto it = reference.find (key);
+          REQUIRE (tree.erase (key) == (it != reference.end () ? 1u : 0u));
+          if (it != reference.end ())
+            reference.erase (it);
+        }
+      if (i % 50 == 0)
+        check_avl_node (tree.root ());
+    }
+  check_avl_node (tree.root ());
+  REQUIRE (tree.size () == reference.size ());
+  REQUIRE (std::equal (tree.begin (), tree.end (), reference.begin (), reference.end ()));
+  auto copy = tree;
+  check_avl_node (copy.root ());
+  REQUIRE (std::equal (copy.begin (), copy.end (), reference.begin (), reference.end ()));
+  for (int key = 0; key < 700; key += 13)
+    REQUIRE (tree.count_less (key) == static_cast<std::size_t> (std::distance (reference.begin (), reference.lower_bound (key))));
+
+  // ascending keys and erasing by iterators keep the tree balanced
+  avl_tree<int> sequential;
+  for (int i = 0; i < 1000; ++i)
+    sequential.insert (sequential.end (), i);
+  check_avl_node (sequential.root ());
+  for (auto it = sequential.begin (); it != sequential.end ();)
+    it = *it % 3 ? sequential.erase (it) : std::next (it);
+  check_avl_node (sequential.root ());
+  REQUIRE (sequential.size () == 334);
+
+  std::vector<int> keys (100);
+  for (int i = 0; i < 100; ++i)
+    keys[i] = i;
+  for (int count : {0, 1, 2, 5, 64, 100})
+    {
+      sequential.assign_sorted (keys.begin (), keys.begin () + count);
+      check_avl_node (sequential.root ());
+      sequential.emplace (-1);
+      check_avl_node (sequential.root ());
+      REQUIRE (sequential.size () == static_cast<std::size_t> (count + 1));
+    }
+}
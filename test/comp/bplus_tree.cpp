@@ -0,0 +1,133 @@
+#include "comp/bplus_tree.h"
+#include "catch.hpp"
+#include <random>
+#include <set>
+#include <vector>
+
+namespace
+{
+  struct heavy_key
+  {
+    heavy_key (int value_arg = 0) : value (value_arg) {}
+    int value;
+    char payload[60] = {};
+    friend bool operator< (const heavy_key &lhs, const heavy_key &rhs) { return lhs.value < rhs.value; }
+    friend bool operator== (const heavy_key &lhs, const heavy_key &rhs) { return lhs.value == rhs.value; }
+  };
+}
+
+// checks key order, separators, fill factor, leaf links and node_count of every node, returns depth
+template <typename Node, typename Key>
+int check_bplus_node (const Node *node, const Key *lower, const Key *upper, bool is_root)
+{
+  if (node->is_leaf ())
+    {
+      auto leaf = node->as_leaf ();
+      if (!is_root)
+        REQUIRE (leaf->size () >= std::decay_t<decltype (*leaf)>::min_size);
+      for (std::size_t i = 0; i < leaf->size (); ++i)
+        {
+          if (lower)
+            REQUIRE (!(leaf->key (i) < *lower));
+          if (upper)
+            REQUIRE (leaf->key (i) < *upper);
+          if (i > 0)
+            REQUIRE (leaf->key (i - 1) < leaf->key (i));
+        }
+      REQUIRE (node->node_count () == leaf->size ());
+      return 1;
+    }
+
+  auto inner = node->as_inner ();
+  REQUIRE (inner->size () >= (is_root ? 2 : std::decay_t<decltype (*inner)>::min_size));
+  int depth = -1;
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < inner->size (); ++i)
+    {
+      REQUIRE (inner->child (i)->parent () == inner);
+      auto child_depth = check_bplus_node (inner->child (i), i > 0 ? &inner->key (i - 1) : lower,
+                                           i + 1 < inner->size () ? &inner->key (i) : upper, false);
+      if (depth >= 0)
+        REQUIRE (child_depth == depth);
+      depth = child_depth;
+      count += inner->child (i)->node_count ();
+    }
+  REQUIRE (node->node_count () == count);
+  return depth + 1;
+}
+
+template <typename Tree>
+void check_bplus_tree (const Tree &tree)
+{
+  if (!tree.root ())
+    return;
+  using key_t = std::decay_t<decltype (*tree.begin ())>;
+  check_bplus_node<typename Tree::node_t, key_t> (tree.root (), nullptr, nullptr, true);
+  REQUIRE (tree.root ()->node_count () == tree.size ());
+}
+
+template <typename Key>
+void random_bplus_test (int operation_count, int max_value)
+{
+  btree::indexed_bplus_tree<Key> tree;
+  std::set<int> etalon;
+  std::mt19937 gen (13);
+  std::uniform_int_distribution<int> uid (0, max_value);
+  for (int i = 0; i < operation_count; ++i)
+    {
+      auto value = uid (gen);
+      if (i % 5 < 2)
+        REQUIRE (tree.erase (value) == etalon.erase (value));
+      else
+        REQUIRE (tree.insert (value) == etalon.insert (value).second);
+      if (i % 1000 == 0)
+        check_bplus_tree (tree);
+    }
+  check_bplus_tree (tree);
+  REQUIRE (tree.size () == etalon.size ());
+  REQUIRE (std::equal (tree.begin (), tree.end (), etalon.begin (), etalon.end (),
+                       [](const Key &lhs, int rhs) { return lhs == Key (rhs); }));
+  std::size_t index = 0;
+  for (auto value : etalon)
+    {
+      REQUIRE (tree.find (value) != tree.end ());
+      REQUIRE (tree.index (value) == index++);
+    }
+  REQUIRE (tree.find (max_value + 1) == tree.end ());
+  REQUIRE (tree.index (max_value + 1) == static_cast<std::size_t> (-1));
+
+  for (auto value : etalon)
+    tree.erase (value);
+  REQUIRE (tree.size () == 0);
+  REQUIRE (tree.begin () == tree.end ());
+}
+
+TEST_CASE ("bplus_tree")
+{
+  using namespace btree;
+  bplus_tree<int> tree;
+  REQUIRE (tree.begin () == tree.end ());
+  for (int i = 1000; i > 0; --i)
+    REQUIRE (tree.insert (i));
+  REQUIRE (!tree.insert (500));
+  REQUIRE (tree.size () == 1000);
+  REQUIRE (*tree.begin () == 1);
+  REQUIRE (*--tree.end () == 1000);
+  REQUIRE (*tree.find (77) == 77);
+  REQUIRE (tree.find (0) == tree.end ());
+  std::vector<int> v;
+  for (auto it = tree.end (); it != tree.begin ();)
+    v.push_back (*--it);
+  REQUIRE (v.size () == 1000);
+  REQUIRE (std::is_sorted (v.rbegin (), v.rend ()));
+  REQUIRE (tree.erase (77) == 1);
+  REQUIRE (tree.erase (77) == 0);
+  REQUIRE (tree.find (77) == tree.end ());
+}
+
+TEST_CASE ("random_bplus_tree_test")
+{
+  random_bplus_test<int> (100000, 20000);
+  // minimal fan-out, deep tree
+  random_bplus_test<heavy_key> (20000, 3000);
+}
@@ -1,6 +1,13 @@
 #include "comp/btree.h"
 #include "catch.hpp"
 #include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
 
 template <typename Tree>
 struct tree_walker
@@ -206,4 +213,1058 @@ TEST_CASE("iterator")
     tree.insert (5);
     REQUIRE (*(--it) == 5);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("pooled_rb_tree")
+{
+  using namespace btree;
+  pooled_indexed_rb_tree<int> tree;
+  std::mt19937 gen (42);
+  std::uniform_int_distribution<int> uid (0, 1000);
+  std::set<int> etalon;
+  for (int i = 0; i < 5000; ++i)
+    {
+      auto val = uid (gen);
+      if (i % 3 == 2)
+        {
+          tree.erase (val);
+          etalon.erase (val);
+        }
+      else if (!etalon.count (val))
+        {
+          tree.insert (val);
+          etalon.insert (val);
+        }
+      if (i % 500 == 0)
+        check_rb_tree (tree);
+    }
+  REQUIRE (tree.size () == etalon.size ());
+  REQUIRE (std::equal (tree.begin (), tree.end (), etalon.begin (), etalon.end ()));
+  for (auto val : etalon)
+    REQUIRE (tree.index (val) == static_cast<std::size_t> (std::distance (etalon.begin (), etalon.find (val))));
+
+  REQUIRE (tree.node_allocator ().slab_bytes () >= tree.size () * sizeof (pooled_indexed_rb_tree<int>::node_t));
+  tree.clear ();
+  REQUIRE (tree.size () == 0);
+  REQUIRE (tree.node_allocator ().slab_count () == 0);
+  REQUIRE (tree.node_allocator ().slab_bytes () == 0);
+
+  // erased node storage is reused by the next insertion
+  tree.insert (1);
+  auto address = &*tree.begin ();
+  tree.erase (1);
+  tree.insert (2);
+  REQUIRE (&*tree.begin () == address);
+}
+
+TEST_CASE("rb_tree_node_size")
+{
+  using namespace btree;
+  // two children, parent with color packed into it and the key itself
+  REQUIRE (sizeof (rb_tree<int>::node_t) == 4 * sizeof (void *));
+  REQUIRE (sizeof (rb_tree<void *>::node_t) == 4 * sizeof (void *));
+  REQUIRE (sizeof (indexed_rb_tree<int>::node_t) == 4 * sizeof (void *) + sizeof (std::size_t));
+}
+
+TEST_CASE("assign_sorted")
+{
+  using namespace btree;
+  for (int count = 0; count < 100; ++count)
+    {
+      std::vector<int> v (count);
+      for (int i = 0; i < count; ++i)
+        v[i] = 2 * i;
+      indexed_rb_tree<int> tree;
+      tree.insert (-1);
+      tree.assign_sorted (v.begin (), v.end ());
+      REQUIRE (tree.size () == v.size ());
+      REQUIRE (std::equal (tree.begin (), tree.end (), v.begin (), v.end ()));
+      if (count == 0)
+        continue;
+      check_rb_tree (tree);
+      REQUIRE (tree.root ()->node_count () == v.size ());
+      for (int i = 0; i < count; ++i)
+        REQUIRE (tree.index (v[i]) == static_cast<std::size_t> (i));
+
+      tree.insert (-1);
+      tree.insert (2 * count);
+      tree.erase (0);
+      check_rb_tree (tree);
+      REQUIRE (tree.index (2 * count) == static_cast<std::size_t> (count));
+    }
+
+  pooled_rb_tree<std::string> tree;
+  std::vector<std::string> v {"a", "b", "c", "d", "e"};
+  tree.assign_sorted (std::make_move_iterator (v.begin ()), std::make_move_iterator (v.end ()));
+  REQUIRE (tree.size () == 5);
+  REQUIRE (*tree.begin () == "a");
+  check_rb_tree (tree);
+}
+
+TEST_CASE("parallel_assign")
+{
+  using namespace btree;
+  std::mt19937 gen (7);
+  std::uniform_int_distribution<int> uid (0, 50000);
+  std::vector<int> v (100000);
+  for (auto &val : v)
+    val = uid (gen);
+  std::set<int> etalon (v.begin (), v.end ());
+  for (unsigned thread_count : {1, 2, 3, 8})
+    {
+      pooled_indexed_rb_tree<int> tree;
+      tree.insert (-5);
+      tree.assign (v.begin (), v.end (), thread_count);
+      REQUIRE (tree.size () == etalon.size ());
+      REQUIRE (tree.root ()->node_count () == etalon.size ());
+      REQUIRE (std::equal (tree.begin (), tree.end (), etalon.begin (), etalon.end ()));
+      check_rb_tree (tree);
+      REQUIRE (tree.index (*etalon.rbegin ()) == etalon.size () - 1);
+      tree.insert (-5);
+      tree.erase (*etalon.begin ());
+      check_rb_tree (tree);
+    }
+
+  rb_tree<std::string> tree;
+  std::vector<std::string> words {"b", "a", "c", "a"};
+  tree.assign (words.begin (), words.end ());
+  REQUIRE (tree.size () == 3);
+  REQUIRE (*tree.begin () == "a");
+}
+
+template <typename Node>
+std::size_t check_node_count (const Node *node)
+{
+  if (!node)
+    return 0;
+  auto count = 1 + check_node_count (node->child (btree::left)) + check_node_count (node->child (btree::right));
+  REQUIRE (node->node_count () == count);
+  return count;
+}
+
+TEST_CASE("random_indexed_rb_tree_test")
+{
+  using namespace btree;
+  indexed_rb_tree<int> tree;
+  std::set<int> etalon;
+  std::mt19937 gen (3);
+  std::uniform_int_distribution<int> uid (0, 3000);
+  for (int i = 0; i < 10000; ++i)
+    {
+      auto val = uid (gen);
+      if (i % 2)
+        {
+          tree.erase (val);
+          etalon.erase (val);
+        }
+      else if (etalon.insert (val).second)
+        tree.insert (val);
+      if (i % 100 == 0)
+        REQUIRE (check_node_count (tree.root ()) == etalon.size ());
+    }
+  std::size_t index = 0;
+  for (auto val : etalon)
+    REQUIRE (tree.index (val) == index++);
+}
+
+TEST_CASE("indexed_rb_tree_select")
+{
+  using namespace btree;
+  indexed_rb_tree<int> tree;
+  REQUIRE (tree.select (0) == tree.end ());
+  std::multiset<int> etalon;
+  std::mt19937 gen (5);
+  std::uniform_int_distribution<int> uid (0, 500);
+  for (int i = 0; i < 1000; ++i)
+    {
+      auto val = uid (gen);
+      tree.insert (val);
+      etalon.insert (val);
+    }
+  std::vector<int> sorted (etalon.begin (), etalon.end ());
+  for (std::size_t k = 0; k < sorted.size (); ++k)
+    REQUIRE (*tree.select (k) == sorted[k]);
+  REQUIRE (tree.select (sorted.size ()) == tree.end ());
+  REQUIRE (std::equal (tree.select (sorted.size () / 2), tree.end (), sorted.begin () + sorted.size () / 2, sorted.end ()));
+
+  for (int lo = -1; lo <= 502; lo += 7)
+    {
+      auto less_count = static_cast<std::size_t> (std::distance (etalon.begin (), etalon.lower_bound (lo)));
+      REQUIRE (tree.count_less (lo) == less_count);
+      for (int hi = lo; hi <= 502; hi += 13)
+        REQUIRE (tree.count_range (lo, hi) == static_cast<std::size_t> (std::distance (etalon.lower_bound (lo), etalon.lower_bound (hi))));
+    }
+  REQUIRE (tree.count_range (10, 5) == 0);
+}
+
+namespace
+{
+  struct to_list_projection
+  {
+    std::string operator() (int key) const { return std::to_string (key) + ","; }
+  };
+}
+
+template <typename Tree, typename Projection, typename Combine>
+void check_aggregation (Tree &tree, Projection projection, Combine combine)
+{
+  std::multiset<int> etalon;
+  std::mt19937 gen (11);
+  std::uniform_int_distribution<int> uid (0, 300);
+  for (int i = 0; i < 1000; ++i)
+    {
+      auto val = uid (gen);
+      if (i % 3 == 2)
+        {
+          if (etalon.count (val))
+            etalon.erase (etalon.find (val));
+          tree.erase (val);
+        }
+      else
+        {
+          tree.insert (val);
+          etalon.insert (val);
+        }
+    }
+  REQUIRE (tree.size () == etalon.size ());
+  for (int lo = -1; lo < 302; lo += 5)
+    for (int hi = lo; hi < 302; hi += 11)
+      {
+        auto first = etalon.lower_bound (lo), last = etalon.lower_bound (hi);
+        auto result = tree.aggregate (lo, hi);
+        REQUIRE (static_cast<bool> (result) == (first != last));
+        if (first == last)
+          continue;
+        auto expected = projection (*first);
+        for (auto it = std::next (first); it != last; ++it)
+          expected = combine (expected, projection (*it));
+        REQUIRE (*result == expected);
+      }
+}
+
+TEST_CASE("aggregation_plugin")
+{
+  using namespace btree;
+  {
+    rb_tree_container<int, aggregation_plugin<long long, identity_projection, std::plus<>>::type, indexation_plugin>::tree_t tree;
+    REQUIRE (!tree.aggregate ());
+    REQUIRE (!tree.aggregate (0, 10));
+    check_aggregation (tree, [](int key) { return static_cast<long long> (key); }, std::plus<> ());
+    check_node_count (tree.root ());
+  }
+  {
+    rb_tree_container<int, aggregation_plugin<int, identity_projection, max_combine>::type>::tree_t tree;
+    check_aggregation (tree, identity_projection (), max_combine ());
+  }
+  {
+    // non-commutative combine keeps key order
+    rb_tree_container<int, aggregation_plugin<std::string, to_list_projection, std::plus<>>::type>::tree_t tree;
+    std::vector<int> keys {1, 2, 3, 4, 5, 6, 7};
+    tree.assign_sorted (keys.begin (), keys.end ());
+    REQUIRE (*tree.aggregate () == "1,2,3,4,5,6,7,");
+    REQUIRE (*tree.aggregate (2, 6) == "2,3,4,5,");
+    tree.clear ();
+    check_aggregation (tree, to_list_projection (), std::plus<> ());
+  }
+}
+
+TEST_CASE("rb_tree_split_join")
+{
+  using namespace btree;
+  for (int count : {0, 1, 2, 3, 10, 100, 1000})
+    for (int split_key = -1; split_key <= count + 1; split_key += std::max (1, count / 7))
+      {
+        indexed_rb_tree<int> tree, right_tree;
+        right_tree.insert (12345);
+        for (int i = 0; i < count; ++i)
+          tree.insert (i);
+        tree.split (split_key, right_tree);
+        auto left_count = static_cast<std::size_t> (std::max (0, std::min (split_key, count)));
+        REQUIRE (tree.size () == left_count);
+        REQUIRE (right_tree.size () == count - left_count);
+        for (auto *t : {&tree, &right_tree})
+          {
+            if (t->size ())
+              check_rb_tree (*t);
+            check_node_count (t->root ());
+          }
+        std::vector<int> keys (tree.begin (), tree.end ());
+        for (std::size_t i = 0; i < keys.size (); ++i)
+          REQUIRE (keys[i] == static_cast<int> (i));
+        REQUIRE (std::distance (right_tree.begin (), right_tree.end ()) == static_cast<std::ptrdiff_t> (right_tree.size ()));
+        if (right_tree.size ())
+          REQUIRE (*right_tree.begin () == static_cast<int> (left_count));
+
+        tree.join (right_tree);
+        REQUIRE (right_tree.size () == 0);
+        REQUIRE (right_tree.begin () == right_tree.end ());
+        REQUIRE (tree.size () == static_cast<std::size_t> (count));
+        if (count)
+          check_rb_tree (tree);
+        check_node_count (tree.root ());
+        std::vector<int> all (tree.begin (), tree.end ());
+        for (int i = 0; i < count; ++i)
+          REQUIRE (all[i] == i);
+        tree.insert (count);
+        tree.erase (0);
+      }
+
+  // trees of very different heights, sizes after split are counted by size () or once by recount ()
+  rb_tree<int> small, large, rest;
+  small.insert (-1);
+  for (int i = 0; i < 5000; ++i)
+    large.insert (i);
+  small.join (large);
+  REQUIRE (small.size () == 5001);
+  check_rb_tree (small);
+  small.split (2500, rest);
+  const auto &const_small = small;
+  REQUIRE (const_small.size () == 2501);
+  REQUIRE (const_small.size () == 2501);
+  REQUIRE (rest.recount () == 2500);
+  REQUIRE (rest.size () == 2500);
+  check_rb_tree (small);
+  check_rb_tree (rest);
+  rest.join (small);
+}
+
+namespace
+{
+  // key which can be compared with plain ints, counting how many times it was constructed
+  struct counted_key
+  {
+    static int constructed;
+    int value;
+    counted_key (int value) : value (value) { ++constructed; }
+    counted_key (const counted_key &other) : value (other.value) { ++constructed; }
+    counted_key& operator= (const counted_key &) = default;
+    bool operator< (const counted_key &other) const { return value < other.value; }
+    bool operator< (int other) const { return value < other; }
+    friend bool operator< (int lhs, const counted_key &rhs) { return lhs < rhs.value; }
+  };
+  int counted_key::constructed = 0;
+}
+
+TEST_CASE("rb_tree_lookup")
+{
+  using namespace btree;
+  rb_tree<int> tree;
+  REQUIRE (tree.find (1) == tree.end ());
+  REQUIRE (tree.lower_bound (1) == tree.end ());
+  REQUIRE (!tree.contains (1));
+
+  std::multiset<int> reference;
+  std::mt19937 gen (11);
+  std::uniform_int_distribution<int> dist (0, 300);
+  for (int i = 0; i < 1000; ++i)
+    {
+      auto key = dist (gen);
+      tree.insert (key);
+      reference.insert (key);
+    }
+  for (int key = -2; key <= 303; ++key)
+    {
+      REQUIRE (tree.contains (key) == (reference.count (key) > 0));
+      auto it = tree.find (key);
+      if (reference.count (key))
+        REQUIRE (*it == key);
+      else
+        REQUIRE (it == tree.end ());
+
+      auto lower = tree.lower_bound (key);
+      auto upper = tree.upper_bound (key);
+      REQUIRE (std::distance (tree.begin (), lower) == std::distance (reference.begin (), reference.lower_bound (key)));
+      REQUIRE (std::distance (tree.begin (), upper) == std::distance (reference.begin (), reference.upper_bound (key)));
+      auto range = tree.equal_range (key);
+      REQUIRE (range.first == lower);
+      REQUIRE (range.second == upper);
+      REQUIRE (static_cast<std::size_t> (std::distance (range.first, range.second)) == reference.count (key));
+    }
+
+  rb_tree<counted_key> counted;
+  for (int i = 0; i < 100; i += 2)
+    counted.insert (counted_key (i));
+  counted_key::constructed = 0;
+  REQUIRE (counted.contains (10));
+  REQUIRE (!counted.contains (11));
+  REQUIRE ((*counted.find (42)).value == 42);
+  REQUIRE ((*counted.lower_bound (43)).value == 44);
+  REQUIRE ((*counted.upper_bound (44)).value == 46);
+  REQUIRE (counted.upper_bound (98) == counted.end ());
+  REQUIRE (counted_key::constructed == 0);
+}
+
+TEST_CASE("rb_tree_hinted_insert")
+{
+  using namespace btree;
+  indexed_rb_tree<int> tree;
+  for (int i = 0; i < 1000; ++i)
+    {
+      auto it = tree.insert (tree.end (), i);
+      REQUIRE (*it == i);
+    }
+  REQUIRE (tree.size () == 1000);
+  check_rb_tree (tree);
+  check_node_count (tree.root ());
+
+  // good, bad and end hints against std::multiset
+  std::multiset<int> reference (tree.begin (), tree.end ());
+  std::mt19937 gen (5);
+  std::uniform_int_distribution<int> dist (-100, 1100);
+  for (int i = 0; i < 3000; ++i)
+    {
+      auto key = dist (gen);
+      auto hint = tree.end ();
+      switch (i % 4)
+        {
+        case 0: hint = tree.lower_bound (key); break;
+        case 1: hint = tree.upper_bound (key); break;
+        case 2: hint = tree.begin (); break;
+        default: break;
+        }
+      auto it = tree.insert (hint, key);
+      reference.insert (key);
+      REQUIRE (*it == key);
+    }
+  check_rb_tree (tree);
+  check_node_count (tree.root ());
+  REQUIRE (std::vector<int> (tree.begin (), tree.end ()) == std::vector<int> (reference.begin (), reference.end ()));
+
+  // sorted runs above, below and across existing keys
+  rb_tree<int> appended;
+  std::vector<int> expected;
+  for (auto run : {std::make_pair (0, 500), std::make_pair (1000, 1500), std::make_pair (250, 1250), std::make_pair (-10, 0)})
+    {
+      std::vector<int> keys;
+      for (int key = run.first; key < run.second; key += 3)
+        keys.push_back (key);
+      appended.append_sorted (keys.begin (), keys.end ());
+      expected.insert (expected.end (), keys.begin (), keys.end ());
+      std::sort (expected.begin (), expected.end ());
+      check_rb_tree (appended);
+      REQUIRE (appended.size () == expected.size ());
+      REQUIRE (std::vector<int> (appended.begin (), appended.end ()) == expected);
+    }
+}
+
+TEST_CASE("rb_tree_node_handles")
+{
+  using namespace btree;
+  indexed_rb_tree<counted_key> tree;
+  for (int i = 0; i < 200; ++i)
+    tree.emplace (i);
+  REQUIRE (counted_key::constructed >= 200);
+  check_rb_tree (tree);
+
+  // re-keying through extract and insert neither allocates nor copies keys
+  std::mt19937 gen (3);
+  std::uniform_int_distribution<int> dist (0, 1000);
+  counted_key::constructed = 0;
+  for (int i = 0; i < 1000; ++i)
+    {
+      auto position = tree.select (dist (gen) % tree.size ());
+      auto next = position;
+      ++next;
+      const counted_key *address = &*position;
+      auto handle = tree.extract (position);
+      REQUIRE (!handle.empty ());
+      REQUIRE (tree.size () == 199);
+      REQUIRE ((next == tree.end () || tree.contains ((*next).value)));
+      handle.key ().value = dist (gen);
+      auto inserted = tree.insert (std::move (handle));
+      REQUIRE (handle.empty ());
+      REQUIRE (&*inserted == address);
+      REQUIRE (tree.size () == 200);
+      check_node_count (tree.root ());
+    }
+  REQUIRE (counted_key::constructed == 0);
+  check_rb_tree (tree);
+
+  REQUIRE (tree.extract (-1).empty ());
+  REQUIRE (tree.insert (decltype (tree)::node_handle ()) == tree.end ());
+
+  // moving nodes between trees and dropping a handle
+  indexed_rb_tree<counted_key> other;
+  while (tree.size () > 100)
+    other.insert (tree.extract (tree.begin ()));
+  {
+    auto dropped = other.extract (other.begin ());
+  }
+  REQUIRE (other.size () == 99);
+  check_rb_tree (tree);
+  check_rb_tree (other);
+  check_node_count (other.root ());
+
+  pooled_rb_tree<std::string> pooled;
+  pooled.emplace (3, 'a');
+  pooled.emplace ("b");
+  auto handle = pooled.extract (std::string ("aaa"));
+  handle.key () = "c";
+  pooled.insert (std::move (handle));
+  REQUIRE ((std::vector<std::string> (pooled.begin (), pooled.end ()) == std::vector<std::string> {"b", "c"}));
+
+  // clear () keeps slabs holding nodes of outstanding handles
+  pooled_rb_tree<int> cleared;
+  for (int i = 0; i < 100; ++i)
+    cleared.insert (i);
+  auto kept = cleared.extract (50);
+  {
+    auto dropped = cleared.extract (60);
+    cleared.clear ();
+    REQUIRE (cleared.size () == 0);
+    REQUIRE (cleared.node_allocator ().handed_out () == 2);
+  }
+  REQUIRE (kept.key () == 50);
+  kept.key () = 7;
+  cleared.insert (std::move (kept));
+  REQUIRE (cleared.node_allocator ().handed_out () == 0);
+  REQUIRE ((std::vector<int> (cleared.begin (), cleared.end ()) == std::vector<int> {7}));
+  cleared.insert (8);
+  check_rb_tree (cleared);
+  cleared.clear ();
+  REQUIRE (cleared.node_allocator ().slab_count () == 0);
+}
+
+TEST_CASE("rb_tree_erase_by_iterator")
+{
+  using namespace btree;
+  indexed_rb_tree<std::string> tree;
+  std::multiset<std::string> reference;
+  std::mt19937 gen (9);
+  std::uniform_int_distribution<int> dist (0, 500);
+  for (int i = 0; i < 2000; ++i)
+    {
+      auto key = std::string (20, 'x') + std::to_string (dist (gen));
+      tree.insert (key);
+      reference.insert (key);
+    }
+
+  // erasing a key leaves other elements in their places
+  std::vector<const std::string *> addresses;
+  for (auto it = tree.begin (); it != tree.end (); ++it)
+    addresses.push_back (&*it);
+  for (int i = 0; i < 500; ++i)
+    {
+      auto index = dist (gen) % tree.size ();
+      auto position = tree.select (index);
+      auto key = *position;
+      auto next = tree.erase (position);
+      reference.erase (reference.find (key));
+      addresses.erase (addresses.begin () + index);
+      REQUIRE ((next == tree.end () || &*next == addresses[index]));
+    }
+  REQUIRE (tree.size () == reference.size ());
+  check_rb_tree (tree);
+  check_node_count (tree.root ());
+  std::size_t index = 0;
+  for (auto it = tree.begin (); it != tree.end (); ++it, ++index)
+    REQUIRE (&*it == addresses[index]);
+  REQUIRE (std::vector<std::string> (tree.begin (), tree.end ()) == std::vector<std::string> (reference.begin (), reference.end ()));
+
+  // erase by key removes nodes in place as well
+  auto kept = tree.select (tree.size () / 2);
+  auto kept_key = *kept;
+  for (auto &key : std::vector<std::string> (reference.begin (), reference.end ()))
+    if (key != kept_key)
+      tree.erase (key);
+  bool kept_found = false;
+  for (auto it = tree.begin (); it != tree.end (); ++it)
+    {
+      REQUIRE (*it == kept_key);
+      kept_found |= it == kept;
+    }
+  REQUIRE (kept_found);
+
+  auto range = tree.equal_range (kept_key);
+  REQUIRE (tree.erase (range.first, range.second) == tree.end ());
+  REQUIRE (tree.size () == 0);
+
+  rb_tree<int> ints;
+  for (int i = 0; i < 1000; ++i)
+    ints.insert (i);
+  auto last = ints.erase (ints.lower_bound (100), ints.lower_bound (900));
+  REQUIRE (*last == 900);
+  REQUIRE (ints.size () == 200);
+  check_rb_tree (ints);
+  ints.erase (ints.begin (), ints.end ());
+  REQUIRE (ints.begin () == ints.end ());
+}
+
+namespace
+{
+  btree::indexed_rb_tree<int> make_range_tree (int first, int last)
+  {
+    btree::indexed_rb_tree<int> tree;
+    for (int i = first; i < last; ++i)
+      tree.insert (i);
+    return tree;
+  }
+
+  template <typename Tree>
+  void check_range_tree (Tree &tree, int first, int last)
+  {
+    REQUIRE (tree.size () == static_cast<std::size_t> (last - first));
+    std::vector<int> expected;
+    for (int i = first; i < last; ++i)
+      expected.push_back (i);
+    REQUIRE (std::vector<int> (tree.begin (), tree.end ()) == expected);
+    if (first != last)
+      {
+        REQUIRE (*--tree.end () == last - 1);
+        check_rb_tree (tree);
+      }
+  }
+}
+
+TEST_CASE("rb_tree_move_and_swap")
+{
+  using namespace btree;
+  auto tree = make_range_tree (0, 100);
+  auto middle = tree.find (50);
+  auto last = tree.find (99);
+
+  auto moved = std::move (tree);
+  REQUIRE (tree.size () == 0);
+  REQUIRE (tree.begin () == tree.end ());
+  check_range_tree (moved, 0, 100);
+  REQUIRE (*middle == 50);
+  REQUIRE (++last == moved.end ());
+  REQUIRE (moved.index (*middle) == 50);
+
+  // the moved from tree stays usable
+  tree.insert (7);
+  check_range_tree (tree, 7, 8);
+
+  auto other = make_range_tree (200, 210);
+  swap (moved, other);
+  check_range_tree (moved, 200, 210);
+  check_range_tree (other, 0, 100);
+  REQUIRE (++other.find (99) == other.end ());
+  other = std::move (moved);
+  check_range_tree (other, 200, 210);
+  moved.swap (other);
+  check_range_tree (moved, 200, 210);
+  REQUIRE (other.begin () == other.end ());
+
+  // trees survive reallocation of a vector and random swaps within it
+  std::vector<indexed_rb_tree<int>> trees;
+  for (int i = 0; i < 300; ++i)
+    trees.push_back (make_range_tree (i, i + i % 5));
+  std::vector<int> firsts (trees.size ());
+  for (std::size_t i = 0; i < firsts.size (); ++i)
+    firsts[i] = static_cast<int> (i);
+  std::mt19937 gen (13);
+  for (int i = 0; i < 1000; ++i)
+    {
+      auto lhs = gen () % trees.size (), rhs = gen () % trees.size ();
+      std::swap (trees[lhs], trees[rhs]);
+      std::swap (firsts[lhs], firsts[rhs]);
+    }
+  for (std::size_t i = 0; i < trees.size (); ++i)
+    check_range_tree (trees[i], firsts[i], firsts[i] + firsts[i] % 5);
+
+  pooled_rb_tree<int> pooled, pooled_other;
+  for (int i = 0; i < 100; ++i)
+    pooled.insert (i);
+  pooled_other = std::move (pooled);
+  pooled.insert (1);
+  check_range_tree (pooled_other, 0, 100);
+  check_range_tree (pooled, 1, 2);
+  std::swap (pooled, pooled_other);
+  check_range_tree (pooled, 0, 100);
+}
+
+TEST_CASE("rb_tree_set_operations")
+{
+  using namespace btree;
+  std::mt19937 gen (7);
+  using tree_t = indexed_rb_tree<int>;
+  using operation_t = std::function<void (tree_t &, tree_t &, unsigned)>;
+  std::vector<std::pair<operation_t, std::function<void (std::vector<int> &, std::vector<int> &, std::vector<int> &)>>> operations = {
+    {[] (tree_t &lhs, tree_t &rhs, unsigned threads) { lhs.union_of (rhs, threads); },
+     [] (std::vector<int> &lhs, std::vector<int> &rhs, std::vector<int> &out) { std::set_union (lhs.begin (), lhs.end (), rhs.begin (), rhs.end (), std::back_inserter (out)); }},
+    {[] (tree_t &lhs, tree_t &rhs, unsigned threads) { lhs.intersection_of (rhs, threads); },
+     [] (std::vector<int> &lhs, std::vector<int> &rhs, std::vector<int> &out) { std::set_intersection (lhs.begin (), lhs.end (), rhs.begin (), rhs.end (), std::back_inserter (out)); }},
+    {[] (tree_t &lhs, tree_t &rhs, unsigned threads) { lhs.difference_of (rhs, threads); },
+     [] (std::vector<int> &lhs, std::vector<int> &rhs, std::vector<int> &out) { std::set_difference (lhs.begin (), lhs.end (), rhs.begin (), rhs.end (), std::back_inserter (out)); }},
+  };
+
+  for (auto &operation : operations)
+    for (int lhs_count : {0, 1, 17, 1000, 30000})
+      for (int rhs_count : {0, 3, 500, 20000})
+        for (unsigned threads : {1u, 4u})
+          {
+            std::uniform_int_distribution<int> dist (0, 2 * std::max (lhs_count, rhs_count));
+            std::set<int> lhs_keys, rhs_keys;
+            for (int i = 0; i < lhs_count; ++i)
+              lhs_keys.insert (dist (gen));
+            for (int i = 0; i < rhs_count; ++i)
+              rhs_keys.insert (dist (gen));
+            std::vector<int> lhs_vector (lhs_keys.begin (), lhs_keys.end ()), rhs_vector (rhs_keys.begin (), rhs_keys.end ()), expected;
+            operation.second (lhs_vector, rhs_vector, expected);
+
+            tree_t lhs, rhs;
+            lhs.assign (lhs_vector.begin (), lhs_vector.end (), 1);
+            for (int key : rhs_vector)
+              rhs.insert (key);
+            operation.first (lhs, rhs, threads);
+            REQUIRE (rhs.size () == 0);
+            REQUIRE (rhs.begin () == rhs.end ());
+            REQUIRE (lhs.size () == expected.size ());
+            if (lhs.size ())
+              check_rb_tree (lhs);
+            check_node_count (lhs.root ());
+            REQUIRE (std::vector<int> (lhs.begin (), lhs.end ()) == expected);
+            lhs.insert (-1);
+            lhs.erase (-1);
+          }
+
+  // sizes follow from the shared keys without node counts
+  auto make_operands = [] (rb_tree<int> &lhs, rb_tree<int> &rhs)
+    {
+      for (int i = 0; i < 100; ++i)
+        {
+          lhs.insert (2 * i);
+          rhs.insert (3 * i);
+        }
+    };
+  {
+    rb_tree<int> lhs, rhs;
+    make_operands (lhs, rhs);
+    lhs.union_of (rhs);
+    REQUIRE (lhs.size () == 166);
+    REQUIRE (std::distance (lhs.begin (), lhs.end ()) == 166);
+    check_rb_tree (lhs);
+  }
+  {
+    rb_tree<int> lhs, rhs;
+    make_operands (lhs, rhs);
+    lhs.intersection_of (rhs);
+    REQUIRE (lhs.size () == 34);
+    REQUIRE (std::distance (lhs.begin (), lhs.end ()) == 34);
+  }
+  {
+    rb_tree<int> lhs, rhs;
+    make_operands (lhs, rhs);
+    lhs.difference_of (rhs);
+    REQUIRE (lhs.size () == 66);
+    REQUIRE (std::distance (lhs.begin (), lhs.end ()) == 66);
+  }
+}
+
+TEST_CASE("stats_plugin")
+{
+  using namespace btree;
+  typename rb_tree_container<int, indexation_plugin, stats_plugin>::tree_t tree;
+  const int count = 1000;
+  for (int i = 0; i < count; ++i)
+    tree.insert (i);
+  check_rb_tree (tree);
+  check_node_count (tree.root ());
+
+  auto stats = tree.stats ();
+  REQUIRE (stats.insertions == static_cast<std::size_t> (count));
+  REQUIRE (stats.allocations == static_cast<std::size_t> (count));
+  REQUIRE (stats.rotations > 0);
+  REQUIRE (stats.recolorings > 0);
+  REQUIRE (stats.comparisons >= static_cast<std::size_t> (count - 1));
+  REQUIRE (stats.max_depth <= 2 * 10);
+  REQUIRE (stats.depth_histogram.size () == stats.max_depth + 1);
+  std::size_t histogram_total = 0;
+  for (auto value : stats.depth_histogram)
+    histogram_total += value;
+  REQUIRE (histogram_total == stats.insertions);
+
+  tree.reset_stats ();
+  REQUIRE (tree.contains (10));
+  REQUIRE (tree.stats ().lookups == 1);
+  REQUIRE (tree.stats ().comparisons > 0);
+  REQUIRE (tree.stats ().comparisons <= 2 * (stats.max_depth + 1));
+
+  // sorted appends at the maximum don't compare keys along the way
+  tree.reset_stats ();
+  for (int i = count; i < 2 * count; ++i)
+    tree.insert (tree.end (), i);
+  REQUIRE (tree.stats ().comparisons == static_cast<std::size_t> (count));
+
+  tree.reset_stats ();
+  for (int i = 0; i < count; ++i)
+    tree.erase (2 * i);
+  REQUIRE (tree.stats ().erasures == static_cast<std::size_t> (count));
+  REQUIRE (tree.stats ().deallocations == static_cast<std::size_t> (count));
+  check_rb_tree (tree);
+
+  tree.clear ();
+  REQUIRE (tree.stats ().deallocations == static_cast<std::size_t> (2 * count));
+}
+
+TEST_CASE("eytzinger_index")
+{
+  using namespace btree;
+  std::mt19937 gen (23);
+  for (int count = 0; count < 70; ++count)
+    {
+      indexed_rb_tree<int> tree;
+      std::vector<int> keys;
+      for (int i = 0; i < count; ++i)
+        {
+          auto key = static_cast<int> (gen () % 50);
+          tree.insert (key);
+          keys.push_back (key);
+        }
+      std::sort (keys.begin (), keys.end ());
+      auto index = tree.freeze ();
+      REQUIRE (index.size () == keys.size ());
+      for (int key = -1; key <= 51; ++key)
+        {
+          auto lower = static_cast<std::size_t> (std::lower_bound (keys.begin (), keys.end (), key) - keys.begin ());
+          auto upper = static_cast<std::size_t> (std::upper_bound (keys.begin (), keys.end (), key) - keys.begin ());
+          REQUIRE (index.lower_bound (key) == lower);
+          REQUIRE (index.upper_bound (key) == upper);
+          REQUIRE (index.lower_bound (key) == tree.count_less (key));
+          REQUIRE (index.contains (key) == (lower != upper));
+        }
+    }
+
+  // ranks agree with index() for unique keys
+  indexed_rb_tree<int> tree;
+  std::vector<int> odd_keys = {1, 3, 5, 7, 9, 11, 13};
+  tree.assign_sorted (odd_keys.begin (), odd_keys.end ());
+  auto index = tree.freeze ();
+  for (int key = 1; key <= 13; key += 2)
+    REQUIRE (index.lower_bound (key) == tree.index (key));
+
+  std::vector<std::string> letters = {"a", "b", "c"};
+  eytzinger_index<std::string> strings (letters.begin (), letters.end ());
+  REQUIRE (strings.lower_bound ("b") == 1);
+  REQUIRE (strings.lower_bound ("d") == 3);
+}
+
+template <typename Node>
+int check_max_high (const Node *node)
+{
+  if (!node)
+    return -1;
+  auto expected = std::max ({node->key ().second, check_max_high (node->child (btree::left)), check_max_high (node->child (btree::right))});
+  REQUIRE (node->subtree_max_high () == expected);
+  return expected;
+}
+
+TEST_CASE("interval_plugin")
+{
+  using namespace btree;
+  using interval = std::pair<int, int>;
+  rb_tree_container<interval, interval_plugin<int>::type>::tree_t tree;
+  REQUIRE (tree.overlapping (0, 10).empty ());
+
+  std::multiset<interval> reference;
+  std::mt19937 gen (31);
+  for (int i = 0; i < 2000; ++i)
+    {
+      auto low = static_cast<int> (gen () % 500);
+      interval key (low, low + static_cast<int> (gen () % 40));
+      if (gen () % 4)
+        {
+          tree.insert (key);
+          reference.insert (key);
+        }
+      else if (reference.count (key))
+        {
+          tree.erase (key);
+          reference.erase (reference.find (key));
+        }
+      if (i % 200)
+        continue;
+
+      check_max_high (tree.root ());
+      for (int lo = -5; lo < 560; lo += 7)
+        {
+          auto hi = lo + static_cast<int> (gen () % 20);
+          std::vector<interval> expected, expected_stab;
+          for (auto &value : reference)
+            {
+              if (value.first <= hi && lo <= value.second)
+                expected.push_back (value);
+              if (value.first <= lo && lo <= value.second)
+                expected_stab.push_back (value);
+            }
+          std::vector<interval> found, found_stab;
+          for (auto it : tree.overlapping (lo, hi))
+            found.push_back (*it);
+          for (auto it : tree.stabbing (lo))
+            found_stab.push_back (*it);
+          REQUIRE (found == expected);
+          REQUIRE (found_stab == expected_stab);
+        }
+    }
+  REQUIRE (tree.overlapping (10, 5).empty ());
+}
+
+TEST_CASE("rb_tree_serialization")
+{
+  using namespace btree;
+  std::mt19937 gen (37);
+  for (int count : {0, 1, 2, 7, 100, 1000})
+    {
+      indexed_rb_tree<std::int64_t> tree;
+      std::multiset<std::int64_t> reference;
+      for (int i = 0; i < count; ++i)
+        {
+          auto key = static_cast<std::int64_t> (gen () % 300) - 100;
+          tree.insert (key);
+          reference.insert (key);
+        }
+      std::stringstream stream;
+      tree.write (stream);
+      auto bytes = stream.str ();
+
+      indexed_rb_tree<std::int64_t> loaded;
+      loaded.insert (5);
+      REQUIRE (loaded.load (stream));
+      if (count)
+        check_rb_tree (loaded);
+      check_node_count (loaded.root ());
+      REQUIRE (loaded.size () == reference.size ());
+      REQUIRE (std::equal (loaded.begin (), loaded.end (), reference.begin (), reference.end ()));
+
+      std::vector<std::uint64_t> buffer ((bytes.size () + 7) / 8);
+      std::memcpy (buffer.data (), bytes.data (), bytes.size ());
+      rb_tree<std::int64_t> mapped;
+      REQUIRE (mapped.load (buffer.data (), bytes.size ()));
+      if (count)
+        check_rb_tree (mapped);
+      REQUIRE (std::equal (mapped.begin (), mapped.end (), reference.begin (), reference.end ()));
+
+      // truncated data or another key type leave the tree alone
+      rb_tree<std::int32_t> other;
+      REQUIRE (!other.load (buffer.data (), bytes.size ()));
+      if (count)
+        {
+          REQUIRE (!mapped.load (buffer.data (), bytes.size () - 1));
+          std::stringstream truncated (bytes.substr (0, bytes.size () - 1));
+          REQUIRE (!loaded.load (truncated));
+          REQUIRE (mapped.size () == reference.size ());
+        }
+    }
+
+  // keys out of order are rejected
+  std::vector<std::int64_t> keys = {1, 2, 3};
+  rb_tree<std::int64_t> tree;
+  tree.assign_sorted (keys.begin (), keys.end ());
+  std::stringstream stream;
+  tree.write (stream);
+  auto bytes = stream.str ();
+  std::swap_ranges (bytes.end () - 16, bytes.end () - 8, bytes.end () - 8);
+  std::vector<std::uint64_t> buffer ((bytes.size () + 7) / 8);
+  std::memcpy (buffer.data (), bytes.data (), bytes.size ());
+  REQUIRE (!tree.load (buffer.data (), bytes.size ()));
+  REQUIRE (tree.size () == 3);
+}
+
+template <typename Node>
+void check_same_shape (const Node *lhs, const Node *rhs)
+{
+  REQUIRE (!lhs == !rhs);
+  if (!lhs)
+    return;
+  REQUIRE (lhs != rhs);
+  REQUIRE (lhs->key () == rhs->key ());
+  REQUIRE (lhs->color () == rhs->color ());
+  REQUIRE (lhs->node_count () == rhs->node_count ());
+  for (auto direction : {btree::left, btree::right})
+    check_same_shape (lhs->child (direction), rhs->child (direction));
+}
+
+namespace
+{
+  // copying throws once copies_left reaches zero
+  struct throwing_key
+  {
+    static int alive;
+    static int copies_left;
+
+    explicit throwing_key (int key) : value (key) { ++alive; }
+    throwing_key (const throwing_key &other) : value (other.value)
+    {
+      if (copies_left-- == 0)
+        throw std::runtime_error ("copy failed");
+      ++alive;
+    }
+    ~throwing_key () { --alive; }
+    bool operator< (const throwing_key &other) const { return value < other.value; }
+
+    int value;
+  };
+
+  int throwing_key::alive = 0;
+  int throwing_key::copies_left = -1;
+}
+
+TEST_CASE("rb_tree_copy")
+{
+  using namespace btree;
+  indexed_rb_tree<int> empty;
+  indexed_rb_tree<int> empty_copy (empty);
+  REQUIRE (empty_copy.size () == 0);
+  REQUIRE (empty_copy.begin () == empty_copy.end ());
+
+  indexed_rb_tree<int> tree;
+  std::mt19937 gen (47);
+  for (int i = 0; i < 500; ++i)
+    tree.insert (static_cast<int> (gen () % 300));
+  for (int i = 0; i < 100; ++i)
+    tree.erase (static_cast<int> (gen () % 300));
+  std::vector<int> keys (tree.begin (), tree.end ());
+
+  auto copy = tree;
+  check_same_shape (tree.root (), copy.root ());
+  REQUIRE (copy.size () == tree.size ());
+  REQUIRE (std::vector<int> (copy.begin (), copy.end ()) == keys);
+  REQUIRE (*--copy.end () == keys.back ());
+
+  // copies are independent
+  copy.insert (1000);
+  copy.erase (keys.front ());
+  check_rb_tree (copy);
+  REQUIRE (std::vector<int> (tree.begin (), tree.end ()) == keys);
+
+  copy = tree;
+  check_same_shape (tree.root (), copy.root ());
+  copy = empty;
+  REQUIRE (copy.size () == 0);
+  copy = tree;
+  tree.clear ();
+  REQUIRE (std::vector<int> (copy.begin (), copy.end ()) == keys);
+
+  pooled_indexed_rb_tree<int> pooled;
+  pooled.assign_sorted (keys.begin (), keys.end ());
+  auto pooled_copy = pooled;
+  check_same_shape (pooled.root (), pooled_copy.root ());
+  REQUIRE (pooled_copy.node_allocator ().slab_count () == 1);
+  pooled_copy.insert (-1);
+  check_rb_tree (pooled_copy);
+  REQUIRE (pooled_copy.size () == keys.size () + 1);
+}
+
+TEST_CASE("rb_tree_copy_throwing_key")
+{
+  using namespace btree;
+  {
+    rb_tree<throwing_key> tree;
+    for (int i = 0; i < 100; ++i)
+      tree.emplace (i);
+    REQUIRE (throwing_key::alive == 100);
+    throwing_key::copies_left = 49;
+    REQUIRE_THROWS_AS (rb_tree<throwing_key> {tree}, std::runtime_error);
+    REQUIRE (throwing_key::alive == 100);
+
+    rb_tree<throwing_key> target;
+    target.emplace (-1);
+    throwing_key::copies_left = 10;
+    REQUIRE_THROWS_AS (target = tree, std::runtime_error);
+    REQUIRE (target.size () == 0);
+    REQUIRE (target.begin () == target.end ());
+    throwing_key::copies_left = -1;
+  }
+  REQUIRE (throwing_key::alive == 0);
+}
@@ -0,0 +1,120 @@
+#include "comp/concurrent_skiplist.h"
+#include "catch.hpp"
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("concurrent_skiplist")
+{
+  using namespace btree;
+  concurrent_skiplist<std::string> set;
+  REQUIRE (set.begin () == set.end ());
+  REQUIRE (!set.erase ("a"));
+
+  std::set<std::string> reference;
+  std::mt19937 gen (19);
+  std::uniform_int_distribution<int> dist (0, 300);
+  for (int i = 0; i < 5000; ++i)
+    {
+      auto key = std::to_string (dist (gen));
+      if (gen () % 2)
+        REQUIRE (set.insert (key) == reference.insert (key).second);
+      else
+        REQUIRE (set.erase (key) == (reference.erase (key) > 0));
+      REQUIRE (set.size () == reference.size ());
+    }
+  REQUIRE (std::vector<std::string> (set.begin (), set.end ()) == std::vector<std::string> (reference.begin (), reference.end ()));
+  for (int i = 0; i <= 300; ++i)
+    {
+      auto key = std::to_string (i);
+      REQUIRE (set.contains (key) == (reference.count (key) > 0));
+      auto lower = set.lower_bound (key);
+      auto expected = reference.lower_bound (key);
+      if (expected == reference.end ())
+        REQUIRE (lower == set.end ());
+      else
+        REQUIRE (*lower == *expected);
+    }
+}
+
+TEST_CASE("concurrent_skiplist_threads")
+{
+  using namespace btree;
+  concurrent_skiplist<int> set;
+  const int thread_count = 8;
+  const int keys_per_thread = 5000;
+  std::atomic<bool> done (false);
+
+  // every thread owns keys equal to its number modulo thread_count, inserts them all and erases odd ones,
+  // while all threads contend on the same neighbourhoods
+  auto writer = [&] (int id)
+  {
+    std::mt19937 gen (id);
+    std::vector<int> keys;
+    for (int i = 0; i < keys_per_thread; ++i)
+      keys.push_back (i * thread_count + id);
+    std::shuffle (keys.begin (), keys.end (), gen);
+    bool ok = true;
+    for (auto key : keys)
+      ok &= set.insert (key);
+    for (auto key : keys)
+      ok &= !set.insert (key);
+    for (auto key : keys)
+      if (key / thread_count % 2)
+        ok &= set.erase (key);
+    for (auto key : keys)
+      ok &= set.contains (key) == (key / thread_count % 2 == 0);
+    return ok;
+  };
+
+  auto reader = [&]
+  {
+    bool sorted = true;
+    while (!done)
+      {
+        int previous = -1;
+        for (auto key : set)
+          {
+            sorted &= previous < key;
+            previous = key;
+          }
+      }
+    return sorted;
+  };
+
+  std::vector<char> results (thread_count + 2);
+  std::vector<std::thread> threads;
+  for (int id = 0; id < thread_count; ++id)
+    threads.emplace_back ([&, id] { results[id] = writer (id); });
+  for (int i = thread_count; i < thread_count + 2; ++i)
+    threads.emplace_back ([&, i] { results[i] = reader (); });
+  for (int id = 0; id < thread_count; ++id)
+    threads[id].join ();
+  done = true;
+  for (auto &thread : threads)
+    if (thread.joinable ())
+      thread.join ();
+  for (auto result : results)
+    REQUIRE (result);
+
+  std::vector<int> expected;
+  for (int key = 0; key < thread_count * keys_per_thread; ++key)
+    if (key / thread_count % 2 == 0)
+      expected.push_back (key);
+  REQUIRE (set.size () == expected.size ());
+  REQUIRE (std::vector<int> (set.begin (), set.end ()) == expected);
+
+  // erased nodes are freed at a quiescent point and the set keeps working
+  REQUIRE (set.retired_count () == expected.size ());
+  REQUIRE (set.reclaim () == expected.size ());
+  REQUIRE (set.retired_count () == 0);
+  REQUIRE (set.erase (0));
+  REQUIRE (set.insert (8));
+  REQUIRE (set.reclaim () == 1);
+  REQUIRE (set.contains (8));
+  REQUIRE (!set.contains (0));
+}
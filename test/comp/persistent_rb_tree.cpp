@@ -0,0 +1,146 @@
+#include "comp/persistent_rb_tree.h"
+#include "catch.hpp"
+#include <atomic>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+// checks order, colors, black heights and node counts, returns black height
+template <typename Node>
+int check_persistent_node (const Node *node)
+{
+  using namespace btree;
+  if (!node)
+    return 0;
+
+  std::size_t count = 1;
+  int height = -1;
+  for (auto direction : {left, right})
+    {
+      auto child = node->child (direction);
+      if (child)
+        {
+          if (direction == left)
+            REQUIRE (!(node->key () < child->key ()));
+          else
+            REQUIRE (!(child->key () < node->key ()));
+          if (node->color () == color_t::red)
+            REQUIRE (child->color () == color_t::black);
+          count += child->node_count ();
+        }
+      auto child_height = check_persistent_node (child);
+      if (height >= 0)
+        REQUIRE (child_height == height);
+      height = child_height;
+    }
+  REQUIRE (node->node_count () == count);
+  return height + (node->color () == color_t::black);
+}
+
+template <typename Snapshot>
+void check_snapshot (const Snapshot &snapshot, const std::vector<int> &expected)
+{
+  if (snapshot.root ())
+    REQUIRE (snapshot.root ()->color () == btree::color_t::black);
+  check_persistent_node (snapshot.root ());
+  REQUIRE (snapshot.size () == expected.size ());
+  REQUIRE (std::vector<int> (snapshot.begin (), snapshot.end ()) == expected);
+}
+
+TEST_CASE("persistent_rb_tree")
+{
+  using namespace btree;
+  persistent_rb_tree<int> tree;
+  REQUIRE (tree.snapshot ().empty ());
+  REQUIRE (tree.snapshot ().begin () == tree.snapshot ().end ());
+
+  std::multiset<int> reference;
+  std::vector<std::pair<persistent_rb_tree<int>::snapshot_t, std::vector<int>>> versions;
+  std::mt19937 gen (17);
+  std::uniform_int_distribution<int> dist (0, 400);
+  for (int i = 0; i < 4000; ++i)
+    {
+      auto key = dist (gen);
+      if (gen () % 3)
+        {
+          tree.insert (key);
+          reference.insert (key);
+        }
+      else
+        {
+          auto it = reference.find (key);
+          REQUIRE (tree.erase (key) == (it != reference.end () ? 1u : 0u));
+          if (it != reference.end ())
+            reference.erase (it);
+        }
+      REQUIRE (tree.size () == reference.size ());
+      if (i % 97 == 0)
+        {
+          versions.emplace_back (tree.snapshot (), std::vector<int> (reference.begin (), reference.end ()));
+          check_snapshot (versions.back ().first, versions.back ().second);
+        }
+    }
+
+  // old versions are not affected by later updates
+  for (auto &version : versions)
+    check_snapshot (version.first, version.second);
+
+  auto snapshot = tree.snapshot ();
+  for (int key = -1; key <= 401; ++key)
+    {
+      REQUIRE (snapshot.contains (key) == (reference.count (key) > 0));
+      auto lower = snapshot.lower_bound (key);
+      auto expected = reference.lower_bound (key);
+      if (expected == reference.end ())
+        REQUIRE (lower == snapshot.end ());
+      else
+        REQUIRE (*lower == *expected);
+    }
+
+  tree.clear ();
+  REQUIRE (tree.size () == 0);
+  check_snapshot (snapshot, std::vector<int> (reference.begin (), reference.end ()));
+}
+
+TEST_CASE("persistent_rb_tree_concurrent_readers")
+{
+  using namespace btree;
+  persistent_rb_tree<int> tree;
+  std::atomic<bool> done (false);
+  const int count = 20000;
+
+  // keys are inserted in order, so every snapshot has to hold a prefix of them
+  auto reader = [&]
+  {
+    bool consistent = true;
+    std::size_t last_size = 0;
+    while (!done)
+      {
+        auto snapshot = tree.snapshot ();
+        int expected = 0;
+        for (auto key : snapshot)
+          consistent &= key == expected++;
+        consistent &= static_cast<std::size_t> (expected) == snapshot.size ();
+        consistent &= snapshot.size () >= last_size;
+        last_size = snapshot.size ();
+      }
+    return consistent;
+  };
+
+  std::vector<char> results (3);
+  std::vector<std::thread> readers;
+  for (auto &result : results)
+    readers.emplace_back ([&] { result = reader (); });
+  for (int i = 0; i < count; ++i)
+    tree.insert (i);
+  for (int i = 0; i < count; i += 2)
+    tree.erase (count + i);
+  done = true;
+  for (auto &thread : readers)
+    thread.join ();
+  for (auto result : results)
+    REQUIRE (result);
+  REQUIRE (tree.size () == static_cast<std::size_t> (count));
+  check_persistent_node (tree.snapshot ().root ());
+}
@@ -0,0 +1,144 @@
+#include "comp/sequence_tree.h"
+#include "catch.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  // checks colors, black heights and node counts, returns black height
+  template <typename Node>
+  int check_sequence_node (const Node *node)
+  {
+    using namespace btree;
+    if (!node)
+      return 0;
+
+    std::size_t count = 1;
+    int height = -1;
+    for (auto direction : {left, right})
+      {
+        auto child = node->child (direction);
+        if (child)
+          {
+            REQUIRE (child->parent () == node);
+            if (node->color () == color_t::red)
+              REQUIRE (child->color () == color_t::black);
+            count += child->node_count ();
+          }
+        auto child_height = check_sequence_node (child);
+        if (height >= 0)
+          REQUIRE (child_height == height);
+        height = child_height;
+      }
+    REQUIRE (node->node_count () == count);
+    return height + (node->color () == color_t::black);
+  }
+
+  template <typename Sequence>
+  void check_sequence (Sequence &sequence, const std::vector<int> &expected)
+  {
+    if (sequence.root ())
+      REQUIRE (sequence.root ()->color () == btree::color_t::black);
+    check_sequence_node (sequence.root ());
+    REQUIRE (sequence.size () == expected.size ());
+    REQUIRE (std::vector<int> (sequence.begin (), sequence.end ()) == expected);
+  }
+}
+
+TEST_CASE("sequence_tree")
+{
+  using namespace btree;
+  sequence_tree<int> sequence;
+  std::vector<int> reference;
+  std::mt19937 gen (53);
+  for (int i = 0; i < 4000; ++i)
+    {
+      auto value = static_cast<int> (gen () % 1000);
+      if (reference.empty () || gen () % 3)
+        {
+          auto index = gen () % (reference.size () + 1);
+          REQUIRE (*sequence.insert_at (index, value) == value);
+          reference.insert (reference.begin () + index, value);
+        }
+      else
+        {
+          auto index = gen () % reference.size ();
+          auto next = sequence.erase_at (index);
+          reference.erase (reference.begin () + index);
+          if (index < reference.size ())
+            REQUIRE (*next == reference[index]);
+          else
+            REQUIRE (next == sequence.end ());
+        }
+      if (i % 100 == 0)
+        {
+          check_sequence (sequence, reference);
+          for (std::size_t index = 0; index < reference.size (); ++index)
+            REQUIRE (sequence.at (index) == reference[index]);
+        }
+    }
+  check_sequence (sequence, reference);
+
+  // values are never compared, so descending and repeated ones keep their positions
+  std::vector<std::string> words {"c", "b", "a", "b"};
+  sequence_tree<std::string> text (words.begin (), words.end ());
+  text.insert_at (1, "z");
+  REQUIRE (std::vector<std::string> (text.begin (), text.end ()) == (std::vector<std::string> {"c", "z", "b", "a", "b"}));
+}
+
+TEST_CASE("sequence_tree_split_and_splice")
+{
+  using namespace btree;
+  std::mt19937 gen (59);
+  for (int count : {0, 1, 2, 3, 10, 77, 300})
+    {
+      std::vector<int> values (count);
+      for (int i = 0; i < count; ++i)
+        values[i] = i;
+      for (int index = 0; index <= count; index += std::max (1, count / 7))
+        {
+          sequence_tree<int> lhs (values.begin (), values.end ()), rhs;
+          rhs.insert_at (0, -1);
+          lhs.split_at (index, rhs);
+          check_sequence (lhs, std::vector<int> (values.begin (), values.begin () + index));
+          check_sequence (rhs, std::vector<int> (values.begin () + index, values.end ()));
+
+          lhs.concat (rhs);
+          check_sequence (lhs, values);
+          check_sequence (rhs, {});
+        }
+    }
+
+  sequence_tree<int> sequence;
+  std::vector<int> reference;
+  for (int i = 0; i < 300; ++i)
+    {
+      sequence_tree<int> other;
+      std::vector<int> other_reference;
+      for (int j = 0, size = static_cast<int> (gen () % 20); j < size; ++j)
+        {
+          other.insert_at (other.size (), i * 100 + j);
+          other_reference.push_back (i * 100 + j);
+        }
+      auto index = gen () % (reference.size () + 1);
+      if (gen () % 2)
+        {
+          sequence.splice (index, other);
+          reference.insert (reference.begin () + index, other_reference.begin (), other_reference.end ());
+          check_sequence (other, {});
+        }
+      else
+        {
+          auto first = gen () % (other_reference.size () + 1);
+          auto last = first + gen () % (other_reference.size () - first + 1);
+          sequence.splice (index, other, first, last);
+          reference.insert (reference.begin () + index, other_reference.begin () + first, other_reference.begin () + last);
+          other_reference.erase (other_reference.begin () + first, other_reference.begin () + last);
+          check_sequence (other, other_reference);
+        }
+      if (i % 30 == 0)
+        check_sequence (sequence, reference);
+    }
+  check_sequence (sequence, reference);
+}
@@ -0,0 +1,128 @@
+#include "comp/splay_tree.h"
+#include "catch.hpp"
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace
+{
+  template <typename Node>
+  std::size_t check_splay_node (const Node *node)
+  {
+    using namespace btree;
+    if (!node)
+      return 0;
+
+    std::size_t count = 1;
+    for (auto direction : {left, right})
+      if (auto child = node->child (direction))
+        {
+          REQUIRE (child->parent () == node);
+          if (direction == left)
+            REQUIRE (!(node->key () < child->key ()));
+          else
+            REQUIRE (!(child->key () < node->key ()));
+          count += check_splay_node (child);
+        }
+    REQUIRE (node->node_count () == count);
+    return count;
+  }
+}
+
+TEST_CASE("splay_tree")
+{
+  using namespace btree;
+  indexed_splay_tree<int> tree;
+  REQUIRE (tree.find (1) == tree.end ());
+  std::multiset<int> reference;
+  std::mt19937 gen (43);
+  for (int i = 0; i < 6000; ++i)
+    {
+      auto key = static_cast<int> (gen () % 700);
+      switch (gen () % 3)
+        {
+        case 0:
+          tree.insert (key);
+          reference.insert (key);
+          REQUIRE (tree.root ()->key () == key);
+          break;
+        case 1:
+          {
+            auto it = reference.find (key);
+            REQUIRE (tree.erase (key) == (it != reference.end () ? 1u : 0u));
+            if (it != reference.end ())
+              reference.erase (it);
+            if (!reference.empty ())
+              {
+                REQUIRE (*tree.begin () == *reference.begin ());
+                REQUIRE (*--tree.end () == *reference.rbegin ());
+              }
+            break;
+          }
+        default:
+          {
+            auto found = tree.find (key);
+            REQUIRE ((found != tree.end ()) == (reference.count (key) > 0));
+            if (found != tree.end ())
+              REQUIRE (tree.root ()->key () == key);
+          }
+        }
+      if (i % 50 == 0)
+        check_splay_node (tree.root ());
+    }
+  check_splay_node (tree.root ());
+  REQUIRE (tree.size () == reference.size ());
+  REQUIRE (std::equal (tree.begin (), tree.end (), reference.begin (), reference.end ()));
+
+  // erasing the minimum or maximum whose child has a subtree of its own
+  splay_tree<int> extremes;
+  for (int key : {1, 3, 2})
+    extremes.insert (key);
+  extremes.find (1);
+  extremes.insert (0);
+  extremes.find (3);
+  extremes.erase (0);
+  REQUIRE (*extremes.begin () == 1);
+  for (int key : {5, 4})
+    extremes.insert (key);
+  extremes.find (3);
+  extremes.insert (6);
+  extremes.find (2);
+  extremes.erase (6);
+  REQUIRE (*--extremes.end () == 5);
+  REQUIRE (std::vector<int> (extremes.begin (), extremes.end ()) == (std::vector<int> {1, 2, 3, 4, 5}));
+
+  // repeated access to a few keys keeps them near the root
+  splay_tree<int> sequential;
+  for (int i = 0; i < 1000; ++i)
+    sequential.insert (sequential.end (), i);
+  REQUIRE (sequential.contains (500));
+  REQUIRE (sequential.contains (501));
+  REQUIRE (sequential.root ()->key () == 501);
+  REQUIRE (sequential.root ()->child (left)->key () == 500);
+  for (auto it = sequential.begin (); it != sequential.end ();)
+    it = *it % 3 ? sequential.erase (it) : std::next (it);
+  REQUIRE (sequential.size () == 334);
+  REQUIRE (std::is_sorted (sequential.begin (), sequential.end ()));
+
+  std::vector<int> keys {1, 2, 3, 4, 5};
+  sequential.assign_sorted (keys.begin (), keys.end ());
+  sequential.emplace (0);
+  REQUIRE (std::equal (sequential.begin (), sequential.end (), std::vector<int> {0, 1, 2, 3, 4, 5}.begin ()));
+}
+
+TEST_CASE("splay_tree_degenerate")
+{
+  using namespace btree;
+  // sequential insertion leaves a single path, walks over it must not recurse per level
+  const int count = 1 << 21;
+  splay_tree<int> tree;
+  for (int i = 0; i < count; ++i)
+    tree.insert (i);
+  REQUIRE (tree.size () == static_cast<std::size_t> (count));
+  auto copy = tree;
+  REQUIRE (*--copy.end () == count - 1);
+  copy.clear ();
+  REQUIRE (copy.size () == 0);
+}
@@ -0,0 +1,86 @@
+#include "comp/veb_index.h"
+#include "comp/btree.h"
+#include "catch.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <vector>
+
+TEST_CASE("veb_layout")
+{
+  // every slot of a perfect tree gets a distinct position and bottom trees are contiguous
+  for (int height = 1; height <= 12; ++height)
+    {
+      btree::detail::veb_layout layout (height);
+      std::vector<std::size_t> path (height);
+      std::vector<char> used (layout.slot_count ());
+      for (std::size_t bfs = 1; bfs <= layout.slot_count (); ++bfs)
+        {
+          int depth = 0;
+          while ((std::size_t (2) << depth) <= bfs)
+            ++depth;
+          for (int d = 0; d <= depth; ++d)
+            path[d] = layout.position (path.data (), d, bfs >> (depth - d));
+          REQUIRE (path[depth] < used.size ());
+          REQUIRE (!used[path[depth]]);
+          used[path[depth]] = 1;
+        }
+    }
+  btree::detail::veb_layout layout (4);
+  std::size_t path[4];
+  path[0] = 0;
+  path[1] = layout.position (path, 1, 2);
+  path[2] = layout.position (path, 2, 5);
+  path[3] = layout.position (path, 3, 11);
+  REQUIRE (path[1] == 1);
+  REQUIRE (path[2] == 6);
+  REQUIRE (path[3] == 8);
+}
+
+TEST_CASE("veb_index")
+{
+  using namespace btree;
+  std::mt19937 gen (29);
+  for (int count = 0; count < 140; ++count)
+    {
+      indexed_rb_tree<std::int64_t> tree;
+      std::vector<std::int64_t> keys;
+      for (int i = 0; i < count; ++i)
+        {
+          auto key = static_cast<std::int64_t> (gen () % 100);
+          tree.insert (key);
+          keys.push_back (key);
+        }
+      std::sort (keys.begin (), keys.end ());
+      auto index = freeze_veb (tree);
+      REQUIRE (index.size () == keys.size ());
+
+      std::stringstream stream;
+      index.write (stream);
+      auto bytes = stream.str ();
+      std::vector<std::uint64_t> buffer ((bytes.size () + 7) / 8);
+      std::memcpy (buffer.data (), bytes.data (), bytes.size ());
+      auto view = veb_index_view<std::int64_t>::from_memory (buffer.data (), bytes.size ());
+      REQUIRE (view);
+
+      for (std::int64_t key = -1; key <= 101; ++key)
+        {
+          auto lower = static_cast<std::size_t> (std::lower_bound (keys.begin (), keys.end (), key) - keys.begin ());
+          auto upper = static_cast<std::size_t> (std::upper_bound (keys.begin (), keys.end (), key) - keys.begin ());
+          REQUIRE (index.lower_bound (key) == lower);
+          REQUIRE (index.lower_bound (key) == tree.count_less (key));
+          REQUIRE (index.upper_bound (key) == upper);
+          REQUIRE (index.contains (key) == (lower != upper));
+          REQUIRE (view->lower_bound (key) == lower);
+          REQUIRE (view->contains (key) == (lower != upper));
+        }
+
+      REQUIRE (!veb_index_view<std::int64_t>::from_memory (buffer.data (), bytes.size () - 1));
+      REQUIRE (!veb_index_view<std::int32_t>::from_memory (buffer.data (), bytes.size ()));
+    }
+
+  std::vector<char> garbage (64, 'x');
+  REQUIRE (!veb_index_view<std::int64_t>::from_memory (garbage.data (), garbage.size ()));
+}